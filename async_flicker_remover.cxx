@@ -0,0 +1,119 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#include "async_flicker_remover.hpp"
+#include <stdexcept>
+
+AsyncFlickerRemover::AsyncFlickerRemover(FlickerRemoverCPU &flicker_remover, unsigned int capacity,
+                                         Callback callback)
+        : flicker_remover(flicker_remover), capacity(capacity), callback(std::move(callback)), frames_in_flight(0),
+          next_ticket(0), processing(false), stopping(false)
+{
+    if(capacity == 0) {
+        throw std::logic_error("Capacity must be bigger than 0.");
+    }
+    worker = std::thread(&AsyncFlickerRemover::work, this);
+}
+
+AsyncFlickerRemover::~AsyncFlickerRemover()
+{
+    {
+        std::lock_guard<std::mutex> lock(guard);
+        stopping = true;
+    }
+    frame_submitted.notify_all();
+    worker.join();
+}
+
+bool AsyncFlickerRemover::submit(const Mat &frame, double timestamp, unsigned long &ticket, string &error, bool wait)
+{
+    std::unique_lock<std::mutex> lock(guard);
+    if(frames_in_flight >= capacity) {
+        if(!wait) {
+            error = "Frame cannot be submitted. Queue is full.";
+            return false;
+        }
+        frame_processed.wait(lock, [this] { return frames_in_flight < capacity; });
+    }
+    ticket = next_ticket++;
+    frames_in_flight++;
+    pending_frames.push_back(PendingFrame{ticket, frame, timestamp, std::chrono::steady_clock::now()});
+    lock.unlock();
+    frame_submitted.notify_one();
+    return true;
+}
+
+bool AsyncFlickerRemover::poll(ProcessedFrame &processed_frame, double timeout)
+{
+    std::unique_lock<std::mutex> lock(guard);
+    if(processed_frames.empty()) {
+        if(timeout <= 0 || !frame_processed.wait_for(lock, std::chrono::duration<double, std::milli>(timeout),
+                                                     [this] { return !processed_frames.empty(); })) {
+            return false;
+        }
+    }
+    processed_frame = std::move(processed_frames.front());
+    processed_frames.pop_front();
+    frames_in_flight--;
+    lock.unlock();
+    //a slot in the queue is free, so a waiting submission may continue
+    frame_processed.notify_all();
+    return true;
+}
+
+void AsyncFlickerRemover::flush()
+{
+    std::unique_lock<std::mutex> lock(guard);
+    frame_processed.wait(lock, [this] { return pending_frames.empty() && !processing; });
+}
+
+unsigned int AsyncFlickerRemover::getNumberOfFramesInFlight() const
+{
+    std::lock_guard<std::mutex> lock(guard);
+    return frames_in_flight;
+}
+
+unsigned int AsyncFlickerRemover::getCapacity() const
+{
+    return capacity;
+}
+
+void AsyncFlickerRemover::work()
+{
+    std::unique_lock<std::mutex> lock(guard);
+    while(true) {
+        frame_submitted.wait(lock, [this] { return stopping || !pending_frames.empty(); });
+        if(pending_frames.empty()) {
+            //stopping, all submitted frames are processed
+            return;
+        }
+        PendingFrame pending_frame = std::move(pending_frames.front());
+        pending_frames.pop_front();
+        processing = true;
+        lock.unlock();
+
+        //the flicker remover is used only by this thread, so it is not guarded
+        ProcessedFrame result{pending_frame.ticket, pending_frame.timestamp, false, Mat(), string(), 0};
+        flicker_remover.setInputLag(std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - pending_frame.submission_time).count());
+        result.removed = flicker_remover.removeFlickering(pending_frame.frame, pending_frame.timestamp, result.frame,
+                                                          result.error);
+        result.latency = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - pending_frame.submission_time).count();
+        //the input is released before the slot is freed, so the caller may reuse its buffer once the frame is delivered
+        pending_frame.frame.release();
+        if(callback) {
+            callback(result);
+        }
+
+        lock.lock();
+        processing = false;
+        if(callback) {
+            frames_in_flight--;
+        } else {
+            processed_frames.push_back(std::move(result));
+        }
+        frame_processed.notify_all();
+    }
+}
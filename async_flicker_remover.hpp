@@ -0,0 +1,198 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#ifndef ASYNC_FLICKER_REMOVER_HPP
+#define ASYNC_FLICKER_REMOVER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <opencv2/opencv.hpp>
+#include "flicker_remover_cpu.hpp"
+
+using cv::Mat;
+using std::string;
+
+/**
+ * @brief Asynchronous front end of FlickerRemoverCPU, so the thread capturing or decoding frames does not wait for
+ * their processing.
+ *
+ * Submitted frames are put into a bounded queue and processed one after another by an internal worker thread, in the
+ * order of submission. Every frame gets a ticket, and processed frames are delivered in the same order either to the
+ * callback, called by the worker, or to <b>poll()</b>. The queue bounds the number of frames in flight (waiting,
+ * being processed and not yet polled), so the memory and the latency stay bounded under burst load: when it is full
+ * <b>submit()</b> either fails at once or waits for a free slot. The lag of every frame is reported to the flicker
+ * remover before it is processed, so its overload policy may shed work when frames wait too long.
+ */
+class AsyncFlickerRemover {
+public:
+    /**
+     * @brief Result of processing of one submitted frame.
+     */
+    struct ProcessedFrame {
+        /**
+         * @brief Ticket returned by <b>submit()</b>.
+         */
+        unsigned long ticket;
+
+        /**
+         * @brief Timestamp of the submitted frame.
+         */
+        double timestamp;
+
+        /**
+         * @brief True if flickering was removed, false in case of an error.
+         */
+        bool removed;
+
+        /**
+         * @brief Frame with removed flickering. Empty in case of an error or if the frame was dropped by the overload
+         * policy.
+         */
+        Mat frame;
+
+        /**
+         * @brief Description of the problem if an error occurs.
+         */
+        string error;
+
+        /**
+         * @brief Time in milliseconds from submission of the frame to the end of its processing.
+         */
+        double latency;
+    };
+
+    /**
+     * @brief Function called by the worker thread for every processed frame. It may take the frame.
+     */
+    typedef std::function<void(ProcessedFrame &)> Callback;
+
+protected:
+    /**
+     * @brief Frame submitted for processing.
+     */
+    struct PendingFrame {
+        unsigned long ticket;
+        Mat frame;
+        double timestamp;
+        std::chrono::steady_clock::time_point submission_time;
+    };
+
+    /**
+     * @brief Flicker remover processing frames. It is not owned by this object.
+     */
+    FlickerRemoverCPU &flicker_remover;
+
+    /**
+     * @brief Maximum number of frames in flight.
+     */
+    unsigned int capacity;
+
+    /**
+     * @brief Receiver of processed frames. If it is empty, they are queued for <b>poll()</b>.
+     */
+    Callback callback;
+
+    std::deque<PendingFrame> pending_frames;
+    std::deque<ProcessedFrame> processed_frames;
+
+    /**
+     * @brief Number of frames submitted and not yet delivered by the callback or <b>poll()</b>.
+     */
+    unsigned int frames_in_flight;
+
+    unsigned long next_ticket;
+
+    /**
+     * @brief True while the worker thread processes a frame taken from the queue.
+     */
+    bool processing;
+
+    /**
+     * @brief Set when the object is destroyed and the worker thread should exit.
+     */
+    bool stopping;
+
+    /**
+     * @brief Guards queues, counters and the stop flag.
+     */
+    mutable std::mutex guard;
+
+    /**
+     * @brief Notified when a frame is submitted or the object is destroyed.
+     */
+    std::condition_variable frame_submitted;
+
+    /**
+     * @brief Notified when a processed frame is delivered or queued for <b>poll()</b>.
+     */
+    std::condition_variable frame_processed;
+
+    std::thread worker;
+
+    /**
+     * @brief Main loop of the worker thread.
+     */
+    void work();
+
+public:
+    /**
+     * @brief Constructor. Starts the worker thread. Throws std::logic_error if the capacity is 0.
+     * @param flicker_remover Flicker remover processing frames. It must outlive this object and it must not be used
+     * directly while frames are in flight (see <b>flush()</b>).
+     * @param capacity Maximum number of frames in flight.
+     * @param callback Function called by the worker thread for every processed frame, in the order of submission. It
+     * must not call methods of this object. If it is empty, processed frames are returned by <b>poll()</b>.
+     */
+    AsyncFlickerRemover(FlickerRemoverCPU &flicker_remover, unsigned int capacity, Callback callback = nullptr);
+    AsyncFlickerRemover(const AsyncFlickerRemover &) = delete;
+    AsyncFlickerRemover &operator=(const AsyncFlickerRemover &) = delete;
+
+    /**
+     * @brief Destructor. Frames already submitted are processed before the worker thread exits, results which were
+     * not polled are discarded.
+     */
+    virtual ~AsyncFlickerRemover();
+
+    /**
+     * @brief Queues the frame for processing. The frame is not copied (Mat is reference counted), so its pixels must
+     * not be changed until it is processed.
+     * @param frame Frame from which flickering will be removed.
+     * @param timestamp Timestamp of the frame. See <b>FlickerRemoverCPU::removeFlickering()</b>.
+     * @param ticket Returned ticket of the frame. Tickets are consecutive numbers starting from 0.
+     * @param error Returned description of the problem if an error occurs.
+     * @param wait If true and the queue is full, waits until a frame is delivered. Without the callback it may wait
+     * forever if no other thread polls processed frames.
+     * @return True if the frame was queued, false if the queue is full and <b>wait</b> is false.
+     */
+    bool submit(const Mat &frame, double timestamp, unsigned long &ticket, string &error, bool wait = false);
+
+    /**
+     * @brief Takes the oldest processed frame. Used only without the callback.
+     * @param processed_frame Returned result of processing.
+     * @param timeout Maximum time in milliseconds of waiting for the frame, 0 returns at once.
+     * @return True if the frame was returned, false if no frame was processed in time.
+     */
+    bool poll(ProcessedFrame &processed_frame, double timeout = 0);
+
+    /**
+     * @brief Waits until all submitted frames are processed. Afterwards, until the next <b>submit()</b>, the flicker
+     * remover may be used directly, for example to save its state or to change its policies.
+     */
+    void flush();
+
+    /**
+     * @brief Number of frames submitted and not yet delivered by the callback or <b>poll()</b>.
+     */
+    [[nodiscard]] unsigned int getNumberOfFramesInFlight() const;
+
+    [[nodiscard]] unsigned int getCapacity() const;
+};
+
+
+#endif //ASYNC_FLICKER_REMOVER_HPP
@@ -0,0 +1,141 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#include "bit_sliced_counter.hpp"
+#include <cstring>
+#include <stdexcept>
+
+BitSlicedCounter::BitSlicedCounter(unsigned int length, unsigned int max_value)
+        : BitSlicedCounter(length, max_value, nullptr)
+{
+    planes = new uint64_t[number_of_words * number_of_planes]();
+    owns_planes = true;
+}
+
+BitSlicedCounter::BitSlicedCounter(unsigned int length, unsigned int max_value, uint64_t *planes)
+        : length(length), planes(planes), owns_planes(false)
+{
+    if(length == 0) {
+        throw std::logic_error("Length must be bigger than 0.");
+    }
+    number_of_words = (length + 63) / 64;
+    number_of_planes = getNumberOfPlanes(max_value);
+}
+
+BitSlicedCounter::~BitSlicedCounter()
+{
+    if(owns_planes) {
+        delete[] planes;
+    }
+}
+
+void BitSlicedCounter::update(unsigned int begin_word, unsigned int end_word, const uint64_t *added,
+                              const uint64_t *removed)
+{
+    for(unsigned int w = begin_word; w < end_word; w++) {
+        //lanes which are both incremented and decremented do not change
+        uint64_t carry = added[w] & ~removed[w];
+        uint64_t borrow = removed[w] & ~added[w];
+        uint64_t *word_planes = planes + w * number_of_planes;
+        //ripple carry adder: sum bit is plane ^ carry, next carry is plane & carry
+        for(unsigned int p = 0; carry != 0 && p < number_of_planes; p++) {
+            uint64_t plane = word_planes[p];
+            word_planes[p] = plane ^ carry;
+            carry &= plane;
+        }
+        //ripple borrow subtractor: difference bit is plane ^ borrow, next borrow is ~plane & borrow
+        for(unsigned int p = 0; borrow != 0 && p < number_of_planes; p++) {
+            uint64_t plane = word_planes[p];
+            word_planes[p] = plane ^ borrow;
+            borrow &= ~plane;
+        }
+    }
+}
+
+void BitSlicedCounter::greaterOrEqual(unsigned int begin_word, unsigned int end_word, unsigned int value,
+                                      uint64_t *result) const
+{
+    if(number_of_planes < 32 && (value >> number_of_planes) != 0) {
+        //value cannot be stored in counters, so it is bigger than all of them
+        std::memset(result, 0, (end_word - begin_word) * sizeof(uint64_t));
+        return;
+    }
+    for(unsigned int w = begin_word; w < end_word; w++) {
+        const uint64_t *word_planes = planes + w * number_of_planes;
+        //compare from the most significant bit, lanes stay in "equal" until the first differing bit
+        uint64_t greater = 0;
+        uint64_t equal = ~(uint64_t) 0;
+        for(unsigned int p = number_of_planes; p-- > 0;) {
+            uint64_t plane = word_planes[p];
+            if(((value >> p) & 1U) != 0) {
+                equal &= plane;
+            } else {
+                greater |= equal & plane;
+                equal &= ~plane;
+            }
+        }
+        result[w - begin_word] = greater | equal;
+    }
+}
+
+void BitSlicedCounter::equal(unsigned int begin_word, unsigned int end_word, unsigned int value,
+                             uint64_t *result) const
+{
+    if(number_of_planes < 32 && (value >> number_of_planes) != 0) {
+        //value cannot be stored in counters, so it is different than all of them
+        std::memset(result, 0, (end_word - begin_word) * sizeof(uint64_t));
+        return;
+    }
+    for(unsigned int w = begin_word; w < end_word; w++) {
+        const uint64_t *word_planes = planes + w * number_of_planes;
+        uint64_t same = ~(uint64_t) 0;
+        for(unsigned int p = 0; p < number_of_planes; p++) {
+            same &= ((value >> p) & 1U) != 0 ? word_planes[p] : ~word_planes[p];
+        }
+        result[w - begin_word] = same;
+    }
+}
+
+unsigned int BitSlicedCounter::at(unsigned int index) const
+{
+    if(index >= length) {
+        throw std::out_of_range("Index out of range.");
+    }
+    const uint64_t *word_planes = planes + (index / 64) * number_of_planes;
+    unsigned int value = 0;
+    for(unsigned int p = 0; p < number_of_planes; p++) {
+        value |= (unsigned int) ((word_planes[p] >> (index % 64)) & 1U) << p;
+    }
+    return value;
+}
+
+void BitSlicedCounter::setZero()
+{
+    std::memset(planes, 0, number_of_words * number_of_planes * sizeof(uint64_t));
+}
+
+void BitSlicedCounter::setZero(unsigned int begin_word, unsigned int end_word)
+{
+    std::memset(planes + begin_word * number_of_planes, 0,
+                (end_word - begin_word) * number_of_planes * sizeof(uint64_t));
+}
+
+unsigned int BitSlicedCounter::getNumberOfPlanes() const
+{
+    return number_of_planes;
+}
+
+unsigned int BitSlicedCounter::getNumberOfPlanes(unsigned int max_value)
+{
+    unsigned int number_of_planes = 1;
+    while(number_of_planes < 32 && (max_value >> number_of_planes) != 0) {
+        number_of_planes++;
+    }
+    return number_of_planes;
+}
+
+size_t BitSlicedCounter::getSize(unsigned int length, unsigned int max_value)
+{
+    return (size_t) (length + 63) / 64 * getNumberOfPlanes(max_value) * sizeof(uint64_t);
+}
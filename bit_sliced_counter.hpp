@@ -0,0 +1,128 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#ifndef BIT_SLICED_COUNTER_HPP
+#define BIT_SLICED_COUNTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Array of small per-pixel counters stored as bit planes.
+ *
+ * Every counter has <b>ceil(log2(max_value + 1))</b> bits. Bit <b>p</b> of counters of 64 consecutive pixels is stored
+ * in one 64-bit word called a plane, so counters of 64 pixels are incremented, decremented and compared with a handful
+ * of word operations (ripple adders working on all 64 lanes at once). Planes of the same 64 pixels are stored next to
+ * each other. Pixels use linear indexes (row * cols + col) and words of flags in the format used by BooleanArray2D:
+ * flag of the pixel <b>i</b> is bit <b>i % 64</b> of word <b>i / 64</b>.
+ */
+class BitSlicedCounter {
+protected:
+    /**
+     * @brief Number of counters.
+     */
+    unsigned int length;
+
+    /**
+     * @brief Number of 64-pixel words of every plane.
+     */
+    unsigned int number_of_words;
+
+    /**
+     * @brief Number of bits of every counter.
+     */
+    unsigned int number_of_planes;
+
+    /**
+     * @brief Planes of counters. Plane <b>p</b> of word <b>w</b> is stored at <b>planes[w * number_of_planes + p]</b>.
+     */
+    uint64_t *planes;
+
+    /**
+     * @brief False if planes are stored in external memory, which is not freed by this counter.
+     */
+    bool owns_planes;
+
+public:
+    /**
+     * @brief Constructor. All counters are set to 0.
+     * @param length Number of counters.
+     * @param max_value Maximum value which counters have to store.
+     */
+    BitSlicedCounter(unsigned int length, unsigned int max_value);
+
+    /**
+     * @brief Constructor of counters stored in external memory, for example in MemoryArena.
+     * @param planes Zeroed memory of <b>getSize(length, max_value)</b> bytes. It must outlive the counter.
+     */
+    BitSlicedCounter(unsigned int length, unsigned int max_value, uint64_t *planes);
+    BitSlicedCounter(const BitSlicedCounter &) = delete;
+    BitSlicedCounter &operator=(const BitSlicedCounter &) = delete;
+    ~BitSlicedCounter();
+
+    /**
+     * @brief Increments counters of pixels with set flags in <b>added</b> and decrements counters of pixels with set
+     * flags in <b>removed</b>. If both flags are set the counter does not change. Counters must stay in range
+     * [0, max_value].
+     * @param begin_word First updated word.
+     * @param end_word Word after the last updated one.
+     * @param added Words of flags of incremented counters, indexed from 0 as the whole array.
+     * @param removed Words of flags of decremented counters, indexed from 0 as the whole array.
+     */
+    void update(unsigned int begin_word, unsigned int end_word, const uint64_t *added, const uint64_t *removed);
+
+    /**
+     * @brief Compares counters with the value.
+     * @param begin_word First compared word.
+     * @param end_word Word after the last compared one.
+     * @param value Compared value.
+     * @param result Returned words of flags of pixels which counters are greater than or equal to <b>value</b>. Word
+     * <b>begin_word</b> is stored in <b>result[0]</b>.
+     */
+    void greaterOrEqual(unsigned int begin_word, unsigned int end_word, unsigned int value, uint64_t *result) const;
+
+    /**
+     * @brief Compares counters with the value.
+     * @param begin_word First compared word.
+     * @param end_word Word after the last compared one.
+     * @param value Compared value.
+     * @param result Returned words of flags of pixels which counters are equal to <b>value</b>. Word
+     * <b>begin_word</b> is stored in <b>result[0]</b>.
+     */
+    void equal(unsigned int begin_word, unsigned int end_word, unsigned int value, uint64_t *result) const;
+
+    /**
+     * @brief Returns the counter of one pixel.
+     * @param index Linear index of the pixel.
+     */
+    [[nodiscard]] unsigned int at(unsigned int index) const;
+
+    /**
+     * @brief Sets all counters to 0.
+     */
+    void setZero();
+
+    /**
+     * @brief Sets counters of words from <b>begin_word</b> to <b>end_word</b> (exclusive) to 0.
+     */
+    void setZero(unsigned int begin_word, unsigned int end_word);
+
+    /**
+     * @brief Number of bits of every counter.
+     */
+    [[nodiscard]] unsigned int getNumberOfPlanes() const;
+
+    /**
+     * @brief Number of bits of counters storing values up to <b>max_value</b>.
+     */
+    static unsigned int getNumberOfPlanes(unsigned int max_value);
+
+    /**
+     * @brief Number of bytes of planes of counters with the given length and maximum value.
+     */
+    static size_t getSize(unsigned int length, unsigned int max_value);
+};
+
+
+#endif //BIT_SLICED_COUNTER_HPP
@@ -3,11 +3,10 @@
 //
 
 #include "boolean_array_2_d.hpp"
-#include <math.h>
 #include <stdexcept>
 
 BooleanArray2D::BooleanArray2D(unsigned int rows, unsigned int cols)
-    : rows(rows), cols(cols)
+    : owns_words(true), rows(rows), cols(cols)
 {
     if(rows == 0) {
         throw std::logic_error("Rows must be bigger than 0.");
@@ -16,13 +15,26 @@ BooleanArray2D::BooleanArray2D(unsigned int rows, unsigned int cols)
         throw std::logic_error("Columns must be bigger than 0.");
     }
 
-    unsigned int size = 8 * (unsigned int) ceil((float) (rows * cols) / 8.0);
-    data = new unsigned char[size];
+    number_of_words = (rows * cols + 63) / 64;
+    words = new uint64_t[number_of_words]();
+}
+
+BooleanArray2D::BooleanArray2D(unsigned int rows, unsigned int cols, uint64_t *words)
+    : words(words), number_of_words((rows * cols + 63) / 64), owns_words(false), rows(rows), cols(cols)
+{
+    if(rows == 0) {
+        throw std::logic_error("Rows must be bigger than 0.");
+    }
+    if(cols == 0) {
+        throw std::logic_error("Columns must be bigger than 0.");
+    }
 }
 
 BooleanArray2D::~BooleanArray2D()
 {
-    delete[] data;
+    if(owns_words) {
+        delete[] words;
+    }
 }
 
 bool BooleanArray2D::at(unsigned int row, unsigned int col) const
@@ -35,11 +47,8 @@ bool BooleanArray2D::at(unsigned int row, unsigned int col) const
     }
 
     unsigned int index = row * cols + col;
-    unsigned int byte_index = index / 8;
-    unsigned int bit_index = index % 8;
-    unsigned char byte = data[byte_index];
-    //is bit with bit_index is set in byte:
-    return (1 == ((byte >> bit_index) & 1U));
+    //is bit with index % 64 set in word:
+    return (1 == ((words[index / 64] >> (index % 64)) & 1U));
 }
 
 void BooleanArray2D::set(unsigned int row, unsigned int col, bool value)
@@ -52,13 +61,32 @@ void BooleanArray2D::set(unsigned int row, unsigned int col, bool value)
     }
 
     unsigned int index = row * cols + col;
-    unsigned int byte_index = index / 8;
-    unsigned int bit_index = index % 8;
-    unsigned char &byte = data[byte_index];
-    //set bit with bit_index in byte to 1 if value is true and to 0 if value is false:
+    uint64_t bit = (uint64_t) 1 << (index % 64);
+    uint64_t &word = words[index / 64];
+    //set bit with index % 64 in word to 1 if value is true and to 0 if value is false:
     if(value) {
-        byte |= 1U << bit_index;
+        word |= bit;
     } else {
-        byte &= ~(1U << bit_index);
+        word &= ~bit;
     }
 }
+
+uint64_t *BooleanArray2D::getWords()
+{
+    return words;
+}
+
+const uint64_t *BooleanArray2D::getWords() const
+{
+    return words;
+}
+
+unsigned int BooleanArray2D::getNumberOfWords() const
+{
+    return number_of_words;
+}
+
+size_t BooleanArray2D::getSize(unsigned int rows, unsigned int cols)
+{
+    return (rows * cols + 63) / 64 * sizeof(uint64_t);
+}
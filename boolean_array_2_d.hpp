@@ -5,21 +5,58 @@
 #ifndef BOOLEAN_ARRAY_2_D_HPP
 #define BOOLEAN_ARRAY_2_D_HPP
 
-#include <bitset>
+#include <cstddef>
+#include <cstdint>
 
 /**
  * @brief Class representing 2D array of booleans. Booleans are represented as single bits for memory efficiency.
+ *
+ * Bits are stored in 64-bit words. Boolean of the element with linear index <b>i</b> (row * cols + col) is stored as
+ * bit <b>i % 64</b> of word <b>i / 64</b>. Bits of the last word after the last element are always 0, so vectorized
+ * algorithms can process whole words.
  */
 class BooleanArray2D {
 protected:
-    unsigned char *data;
+    uint64_t *words;
+    unsigned int number_of_words;
+
+    /**
+     * @brief False if words are stored in external memory, which is not freed by this array.
+     */
+    bool owns_words;
+
 public:
     unsigned int rows;
     unsigned int cols;
     BooleanArray2D(unsigned int rows, unsigned int cols);
+
+    /**
+     * @brief Constructor of the array stored in external memory, for example in MemoryArena.
+     * @param words Zeroed memory of <b>getSize(rows, cols)</b> bytes. It must outlive the array.
+     */
+    BooleanArray2D(unsigned int rows, unsigned int cols, uint64_t *words);
+    BooleanArray2D(const BooleanArray2D &) = delete;
+    BooleanArray2D &operator=(const BooleanArray2D &) = delete;
     ~BooleanArray2D();
     [[nodiscard]] bool at(unsigned int row, unsigned int col) const;
     void set(unsigned int row, unsigned int col, bool value);
+
+    /**
+     * @brief Gives direct access to words of bits for vectorized algorithms.
+     * @return Pointer to the first word.
+     */
+    uint64_t *getWords();
+    [[nodiscard]] const uint64_t *getWords() const;
+
+    /**
+     * @brief Number of words of bits.
+     */
+    [[nodiscard]] unsigned int getNumberOfWords() const;
+
+    /**
+     * @brief Number of bytes of words of the array of the given size.
+     */
+    static size_t getSize(unsigned int rows, unsigned int cols);
 };
 
 
@@ -5,8 +5,23 @@
 #ifndef CIRCULAR_BUFFER_HPP
 #define CIRCULAR_BUFFER_HPP
 
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
 
-template<class T>
+
+/**
+ * @brief Constant length circular buffer.
+ *
+ * Buffers of pointers (<b>CircularBuffer&lt;T *&gt;</b>) store pointers to elements owned by the caller. Other buffers
+ * store elements by value: <b>CircularBuffer&lt;T, N&gt;</b> keeps <b>N</b> elements inline in the object and
+ * <b>CircularBuffer&lt;T&gt;</b> allocates slots for the length given at runtime once.
+ *
+ * @tparam T A type of elements.
+ * @tparam N Length of the buffer known at compile time or 0 if it is given to the constructor.
+ */
+template<class T, unsigned int N = 0>
 class CircularBuffer;
 
 
@@ -21,7 +36,7 @@ class CircularBuffer;
  * @tparam T A type of elements to which pointers will be stored in buffer. It can be any type.
  */
 template<class T>
-class CircularBuffer<T *> {
+class CircularBuffer<T *, 0> {
 protected:
 
     /**
@@ -77,7 +92,7 @@ public:
      * @return Pointer to removed first element from the buffer when it was full or <b>nullptr</b> when buffer was not
      * full before adding pointer to the element.
      */
-    virtual T *push(T *element);
+    T *push(T *element);
 
     /**
      * @brief Removes and returns pointer to the first element in the buffer.
@@ -85,7 +100,7 @@ public:
      * Number of stored elements in the buffer is decreased.
      * @return Removed pointer from the buffer or <b>nullptr</b> when the buffer is empty.
      */
-    virtual T *pop();
+    T *pop();
 
     /**
      * @brief Random access operator.
@@ -329,7 +344,7 @@ void CircularBuffer<T *>::clear()
     count_of_elements = 0;
     first_element_index = 0; //initial value is not important, these values are always set when elements are
     last_element_index = 0; //added or removed to/from buffer
-    for(int i = 0; i < count_of_slots; i++) {
+    for(unsigned int i = 0; i < count_of_slots; i++) {
         data[i] = nullptr;
     }
 }
@@ -353,4 +368,408 @@ void CircularBuffer<T *>::setMaxSize(unsigned int new_size)
     }
 }
 
+
+/**
+ * @brief Common part of circular buffers storing elements of type T by value.
+ *
+ * Elements are moved into the buffer with <b>push()</b> and moved out with <b>pop()</b>, so move-only types are
+ * supported and types like Mat, which share data on copy, are not copied. Only slots holding elements contain
+ * constructed objects. If the length of the buffer is a power of 2, indexes of slots are masked, otherwise the index
+ * after the last slot is wrapped with one comparison, so no division is needed.
+ *
+ * @tparam T A type of elements. It must be movable and default constructible.
+ */
+template<class T>
+class CircularValueBuffer {
+protected:
+    /**
+     * Actual number of elements stored in the buffer.
+     */
+    unsigned int count_of_elements;
+
+    /**
+     * The length of the buffer. Maximum number of elements that can be stored in the buffer.
+     */
+    unsigned int count_of_slots;
+
+    /**
+     * <b>count_of_slots - 1</b> if the length is a power of 2, 0 otherwise.
+     */
+    unsigned int index_mask;
+
+    /**
+     * Index of the slot of the first element, which is the element added before all other elements in the buffer.
+     */
+    unsigned int first_element_index;
+
+    /**
+     * Slots of elements, owned by the derived class.
+     */
+    T *slots;
+
+    /**
+     * @brief Constructor used by derived classes, which provide slots.
+     */
+    CircularValueBuffer(T *slots, unsigned int size);
+
+    /**
+     * @brief Destructor. Derived classes destroy elements with <b>clear()</b> before their slots are freed.
+     */
+    ~CircularValueBuffer() = default;
+
+    /**
+     * @brief Sets new slots, which must be empty.
+     */
+    void setSlots(T *new_slots, unsigned int new_size);
+
+    /**
+     * @brief Returns the index of the slot of the element at <b>position</b> counting from the first element.
+     * @param position Position less than twice the length of the buffer.
+     */
+    unsigned int slotIndex(unsigned int position) const;
+
+public:
+    CircularValueBuffer(const CircularValueBuffer &) = delete;
+    CircularValueBuffer &operator=(const CircularValueBuffer &) = delete;
+
+    /**
+     * @brief Moves the element at the end of the buffer.
+     *
+     * If the buffer is full it removes and returns the first element, so the caller can reuse it. A buffer of length 0
+     * stores nothing, so it returns the pushed element at once.
+     * @param element Element that will be stored in the buffer.
+     * @return Removed first element when the buffer was full, the pushed element when the length of the buffer is 0
+     * or default constructed element otherwise.
+     */
+    T push(T &&element);
+
+    /**
+     * @brief Copies the element at the end of the buffer. See <b>push(T &&)</b>.
+     */
+    T push(const T &element);
+
+    /**
+     * @brief Removes and returns the first element in the buffer.
+     * @return Removed element or default constructed element when the buffer is empty.
+     */
+    T pop();
+
+    /**
+     * @brief Random access operator.
+     *
+     * Returns the element with <b>index</b> counting from the first element. The range is not checked.
+     * @param index Number of returned element starting form 0 as the first element. It can be a negative value: -1
+     * means the last element, -2 means one before the last element and so on. It must be in range
+     * [-size(), size()).
+     */
+    T &operator[](int index);
+    const T &operator[](int index) const;
+
+    /**
+     * @brief Returns the element with <b>index</b> like <b>operator[]</b>, but throws std::out_of_range if there is
+     * no such element.
+     */
+    T &at(int index);
+    const T &at(int index) const;
+
+    /**
+     * @brief Returns the last element, added after all other elements. The buffer must not be empty.
+     */
+    T &last();
+    const T &last() const;
+
+    /**
+     * @brief Returns the first element, added before all other elements. The buffer must not be empty.
+     */
+    T &first();
+    const T &first() const;
+
+    /**
+     * @brief Actual number of elements stored in the buffer.
+     */
+    unsigned int size() const;
+
+    /**
+     * @brief Maximum number of elements that can be stored in the buffer.
+     */
+    unsigned int maxSize() const;
+
+    /**
+     * @brief True if number of stored elements is equal to the length of the buffer, false otherwise.
+     */
+    bool isFull() const;
+
+    /**
+     * @brief True if number of stored elements is equal to zero, false otherwise.
+     */
+    bool isEmpty() const;
+
+    /**
+     * @brief Destroys all elements stored in the buffer.
+     */
+    void clear();
+};
+
+
+/**
+ * @brief Circular buffer storing up to <b>N</b> elements of type T inline, without any allocation.
+ */
+template<class T, unsigned int N>
+class CircularBuffer : public CircularValueBuffer<T> {
+protected:
+    /**
+     * Memory of slots. Objects are constructed in it only for stored elements.
+     */
+    alignas(T) unsigned char storage[N * sizeof(T)];
+
+public:
+    static_assert(N > 0, "Length of the buffer must be bigger than 0.");
+
+    CircularBuffer();
+
+    /**
+     * @brief Destructor. Destroys stored elements.
+     */
+    ~CircularBuffer();
+};
+
+
+/**
+ * @brief Circular buffer storing elements of type T in slots allocated once for the length given at runtime.
+ */
+template<class T>
+class CircularBuffer<T, 0> : public CircularValueBuffer<T> {
+protected:
+    std::allocator<T> allocator;
+
+public:
+    /**
+     * @brief Buffer constructor. Allocates slots for <b>size</b> elements, but does not construct them.
+     * @param size Length of the buffer.
+     */
+    explicit CircularBuffer(unsigned int size);
+
+    /**
+     * @brief Destructor. Destroys stored elements and frees slots.
+     */
+    ~CircularBuffer();
+
+    /**
+     * @brief Destroys all elements and allocates slots again for the new length.
+     * @param new_size New length of the buffer.
+     */
+    void setMaxSize(unsigned int new_size);
+};
+
+
+//------------------------------ IMPLEMENTATION ------------------------------
+
+template<class T>
+CircularValueBuffer<T>::CircularValueBuffer(T *slots, unsigned int size)
+    : count_of_elements(0), count_of_slots(0), index_mask(0), first_element_index(0), slots(nullptr)
+{
+    setSlots(slots, size);
+}
+
+
+template<class T>
+void CircularValueBuffer<T>::setSlots(T *new_slots, unsigned int new_size)
+{
+    slots = new_slots;
+    count_of_slots = new_size;
+    first_element_index = 0;
+    //lengths which are powers of 2 have a single bit set
+    index_mask = (new_size & (new_size - 1)) == 0 && new_size > 0 ? new_size - 1 : 0;
+}
+
+
+template<class T>
+unsigned int CircularValueBuffer<T>::slotIndex(unsigned int position) const
+{
+    if(index_mask != 0) {
+        return position & index_mask;
+    }
+    return position >= count_of_slots ? position - count_of_slots : position;
+}
+
+
+template<class T>
+T CircularValueBuffer<T>::push(T &&element)
+{
+    if(count_of_slots == 0) {
+        //there are no slots, so the element is evicted as soon as it is added
+        return T(std::move(element));
+    }
+    T ret{};
+    if(count_of_elements == count_of_slots) {
+        //remove first element to make room for the new one, return it so the caller can reuse it
+        ret = pop();
+    }
+    new(slots + slotIndex(first_element_index + count_of_elements)) T(std::move(element));
+    count_of_elements++;
+    return ret;
+}
+
+
+template<class T>
+T CircularValueBuffer<T>::push(const T &element)
+{
+    return push(T(element));
+}
+
+
+template<class T>
+T CircularValueBuffer<T>::pop()
+{
+    if(count_of_elements == 0) {
+        return T{};
+    }
+    T &first_element = slots[first_element_index];
+    T ret(std::move(first_element));
+    first_element.~T();
+    first_element_index = slotIndex(first_element_index + 1);
+    count_of_elements--;
+    return ret;
+}
+
+
+template<class T>
+T &CircularValueBuffer<T>::operator[](int index)
+{
+    return slots[slotIndex(first_element_index + (index >= 0 ? index : (int) count_of_elements + index))];
+}
+
+
+template<class T>
+const T &CircularValueBuffer<T>::operator[](int index) const
+{
+    return slots[slotIndex(first_element_index + (index >= 0 ? index : (int) count_of_elements + index))];
+}
+
+
+template<class T>
+T &CircularValueBuffer<T>::at(int index)
+{
+    if(index >= (int) count_of_elements || index < -1 * ((int) count_of_elements)) {
+        throw std::out_of_range("Index out of range.");
+    }
+    return (*this)[index];
+}
+
+
+template<class T>
+const T &CircularValueBuffer<T>::at(int index) const
+{
+    if(index >= (int) count_of_elements || index < -1 * ((int) count_of_elements)) {
+        throw std::out_of_range("Index out of range.");
+    }
+    return (*this)[index];
+}
+
+
+template<class T>
+T &CircularValueBuffer<T>::last()
+{
+    return (*this)[-1];
+}
+
+
+template<class T>
+const T &CircularValueBuffer<T>::last() const
+{
+    return (*this)[-1];
+}
+
+
+template<class T>
+T &CircularValueBuffer<T>::first()
+{
+    return slots[first_element_index];
+}
+
+
+template<class T>
+const T &CircularValueBuffer<T>::first() const
+{
+    return slots[first_element_index];
+}
+
+
+template<class T>
+unsigned int CircularValueBuffer<T>::size() const
+{
+    return count_of_elements;
+}
+
+
+template<class T>
+unsigned int CircularValueBuffer<T>::maxSize() const
+{
+    return count_of_slots;
+}
+
+
+template<class T>
+bool CircularValueBuffer<T>::isFull() const
+{
+    return (count_of_elements == count_of_slots);
+}
+
+
+template<class T>
+bool CircularValueBuffer<T>::isEmpty() const
+{
+    return (count_of_elements == 0);
+}
+
+
+template<class T>
+void CircularValueBuffer<T>::clear()
+{
+    for(unsigned int i = 0; i < count_of_elements; i++) {
+        slots[slotIndex(first_element_index + i)].~T();
+    }
+    count_of_elements = 0;
+    first_element_index = 0;
+}
+
+
+template<class T, unsigned int N>
+CircularBuffer<T, N>::CircularBuffer() : CircularValueBuffer<T>(reinterpret_cast<T *>(storage), N)
+{
+}
+
+
+template<class T, unsigned int N>
+CircularBuffer<T, N>::~CircularBuffer()
+{
+    this->clear();
+}
+
+
+template<class T>
+CircularBuffer<T, 0>::CircularBuffer(unsigned int size)
+    : CircularValueBuffer<T>(nullptr, 0)
+{
+    setMaxSize(size);
+}
+
+
+template<class T>
+CircularBuffer<T, 0>::~CircularBuffer()
+{
+    setMaxSize(0);
+}
+
+
+template<class T>
+void CircularBuffer<T, 0>::setMaxSize(unsigned int new_size)
+{
+    this->clear();
+    if(this->slots != nullptr) {
+        allocator.deallocate(this->slots, this->count_of_slots);
+    }
+    this->setSlots(new_size > 0 ? allocator.allocate(new_size) : nullptr, new_size);
+}
+
 #endif //CIRCULAR_BUFFER_HPP
@@ -0,0 +1,72 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#ifndef CPU_KERNEL_VARIANT_HPP
+#define CPU_KERNEL_VARIANT_HPP
+
+#include <cstdint>
+
+/**
+ * @brief Table of the hottest loops of CPUKernels compiled for one x86 instruction set.
+ *
+ * Every variant is defined in its own translation unit compiled with flags enabling its instruction set, so it must
+ * be used only on processors supporting it. CPUKernels selects the best supported variant at startup and uses
+ * universal intrinsics for everything else. Every function processes only whole vectors from the beginning of the
+ * range and returns the linear index after the last processed pixel, so remaining pixels are processed by the
+ * baseline code of CPUKernels. Parameters have the same meaning as in CPUKernels, frames and masks are passed as data
+ * pointers and group strides of PixelPlane. Pointers to functions are nullptr if the variant was not compiled for the
+ * platform.
+ *
+ * Translation units of variants must not use inline functions of other headers (also templates of the standard
+ * library), because their copies compiled with wider instruction sets could be picked by the linker for the rest of
+ * the program.
+ */
+struct CPUKernelVariant {
+    /**
+     * @brief Name of the instruction set.
+     */
+    const char *name;
+
+    /**
+     * @brief Subtracts mask from lane groups of the frame. <b>begin</b> must be a multiple of 16. <b>mask</b> may be
+     * nullptr.
+     */
+    unsigned int (*apply_mask_wide)(const unsigned char *src, const int *mask, unsigned int mask_stride,
+                                    unsigned int begin, unsigned int end, int *dst, unsigned int dst_stride);
+    unsigned int (*apply_mask_narrow)(const unsigned char *src, const short *mask, unsigned int mask_stride,
+                                      unsigned int begin, unsigned int end, unsigned char *dst,
+                                      unsigned int dst_stride);
+
+    /**
+     * @brief Updates similarity flags of whole words of flags. <b>begin</b> must be a multiple of 64 and
+     * <b>threshold</b> must not be negative. <b>dst_levels</b> may be nullptr.
+     */
+    unsigned int (*update_similarity_levels_wide)(const int *src_1, unsigned int stride_1, const int *src_2,
+                                                  unsigned int stride_2, unsigned int begin, unsigned int end,
+                                                  int threshold, const uint64_t *old_levels, uint64_t *new_levels,
+                                                  unsigned char *dst_levels);
+    unsigned int (*update_similarity_levels_narrow)(const unsigned char *src_1, unsigned int stride_1,
+                                                    const unsigned char *src_2, unsigned int stride_2,
+                                                    unsigned int begin, unsigned int end, int threshold,
+                                                    const uint64_t *old_levels, uint64_t *new_levels,
+                                                    unsigned char *dst_levels);
+
+    /**
+     * @brief Increments flicker counters of flickering pixels and zeroes counters of other pixels. Flags of pixels
+     * which counters exceed <b>max_duration</b> are set in <b>exceeded</b>, which uses the format of
+     * <b>CPUKernels::findCandidates()</b> and must be zeroed. <b>max_duration</b> must be less than 255.
+     */
+    unsigned int (*update_flicker_counter)(const uint64_t *flickering, unsigned int max_duration, unsigned int begin,
+                                           unsigned int end, unsigned char *flicker_counter, uint64_t *exceeded);
+};
+
+/**
+ * @brief Variants for SSE4.2, AVX2 and AVX-512 (F and BW).
+ */
+extern const CPUKernelVariant sse42_kernel_variant;
+extern const CPUKernelVariant avx2_kernel_variant;
+extern const CPUKernelVariant avx512_kernel_variant;
+
+
+#endif //CPU_KERNEL_VARIANT_HPP
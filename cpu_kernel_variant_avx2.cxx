@@ -0,0 +1,182 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#include "cpu_kernel_variant.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace {
+
+const unsigned int LANES = 16;
+
+/**
+ * @brief Expands 32 lowest bits of the word of flags into a vector of bytes with values 0xFF or 0.
+ */
+__m256i expandFlags(uint64_t flags)
+{
+    //shuffling works inside 128-bit halves, every half has its copy of all 4 bytes of flags
+    const __m256i shuffle = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                             2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i bits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                          1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    __m256i bytes = _mm256_shuffle_epi8(_mm256_set1_epi32((int) (unsigned int) flags), shuffle);
+    return _mm256_cmpeq_epi8(_mm256_and_si256(bytes, bits), bits);
+}
+
+/**
+ * @brief Loads 2 lane groups into one vector.
+ */
+__m256i loadGroups(const unsigned char *group_0, const unsigned char *group_1)
+{
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) group_0)),
+                                   _mm_loadu_si128((const __m128i *) group_1), 1);
+}
+
+/**
+ * @brief Compares absolute differences of 8 pairs of ints as unsigned ints with the threshold.
+ * @return Flags of similar pixels.
+ */
+unsigned int similarInts(const int *src_1, const int *src_2, __m256i threshold)
+{
+    __m256i a = _mm256_loadu_si256((const __m256i *) src_1);
+    __m256i b = _mm256_loadu_si256((const __m256i *) src_2);
+    __m256i diff = _mm256_sub_epi32(_mm256_max_epi32(a, b), _mm256_min_epi32(a, b));
+    __m256i similar = _mm256_cmpeq_epi32(_mm256_min_epu32(diff, threshold), diff);
+    return (unsigned int) _mm256_movemask_ps(_mm256_castsi256_ps(similar));
+}
+
+unsigned int applyMaskWide(const unsigned char *src, const int *mask, unsigned int mask_stride, unsigned int begin,
+                           unsigned int end, int *dst, unsigned int dst_stride)
+{
+    unsigned int i = begin;
+    for(; i + LANES <= end; i += LANES) {
+        __m128i pixels = _mm_loadu_si128((const __m128i *) (src + i));
+        __m256i dst_lo = _mm256_cvtepu8_epi32(pixels);
+        __m256i dst_hi = _mm256_cvtepu8_epi32(_mm_srli_si128(pixels, 8));
+        if(mask != nullptr) {
+            const int *mask_group = mask + i / LANES * mask_stride;
+            dst_lo = _mm256_sub_epi32(dst_lo, _mm256_loadu_si256((const __m256i *) mask_group));
+            dst_hi = _mm256_sub_epi32(dst_hi, _mm256_loadu_si256((const __m256i *) (mask_group + 8)));
+        }
+        int *dst_group = dst + i / LANES * dst_stride;
+        _mm256_storeu_si256((__m256i *) dst_group, dst_lo);
+        _mm256_storeu_si256((__m256i *) (dst_group + 8), dst_hi);
+    }
+    return i;
+}
+
+unsigned int applyMaskNarrow(const unsigned char *src, const short *mask, unsigned int mask_stride,
+                             unsigned int begin, unsigned int end, unsigned char *dst, unsigned int dst_stride)
+{
+    unsigned int i = begin;
+    for(; i + LANES <= end; i += LANES) {
+        __m128i pixels = _mm_loadu_si128((const __m128i *) (src + i));
+        unsigned char *dst_group = dst + i / LANES * dst_stride;
+        if(mask == nullptr) {
+            _mm_storeu_si128((__m128i *) dst_group, pixels);
+            continue;
+        }
+        //saturating subtraction of shorts followed by saturating packing gives the same result as saturation of the
+        //exact difference
+        __m256i diff = _mm256_subs_epi16(_mm256_cvtepu8_epi16(pixels),
+                                         _mm256_loadu_si256((const __m256i *) (mask + i / LANES * mask_stride)));
+        __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(diff), _mm256_extracti128_si256(diff, 1));
+        _mm_storeu_si128((__m128i *) dst_group, packed);
+    }
+    return i;
+}
+
+/**
+ * @brief Updates sums of levels of 64 pixels. Flags are all ones for 0xFF bytes, so subtracting new flags and adding
+ * old ones adds 1 for similar pixels and subtracts 1 for previously similar ones.
+ */
+void updateSums(unsigned char *dst_levels, uint64_t old_word, uint64_t new_word)
+{
+    for(unsigned int part = 0; part < 64; part += 32) {
+        __m256i sum = _mm256_loadu_si256((const __m256i *) (dst_levels + part));
+        sum = _mm256_add_epi8(_mm256_sub_epi8(sum, expandFlags(new_word >> part)), expandFlags(old_word >> part));
+        _mm256_storeu_si256((__m256i *) (dst_levels + part), sum);
+    }
+}
+
+unsigned int updateSimilarityLevelsWide(const int *src_1, unsigned int stride_1, const int *src_2,
+                                        unsigned int stride_2, unsigned int begin, unsigned int end, int threshold,
+                                        const uint64_t *old_levels, uint64_t *new_levels, unsigned char *dst_levels)
+{
+    const __m256i v_threshold = _mm256_set1_epi32(threshold);
+    unsigned int i = begin;
+    for(; i + 64 <= end; i += 64) {
+        uint64_t new_word = 0;
+        for(unsigned int part = 0; part < 64; part += LANES) {
+            const int *group_1 = src_1 + (i + part) / LANES * stride_1;
+            const int *group_2 = src_2 + (i + part) / LANES * stride_2;
+            unsigned int bits = similarInts(group_1, group_2, v_threshold) |
+                                similarInts(group_1 + 8, group_2 + 8, v_threshold) << 8;
+            new_word |= (uint64_t) bits << part;
+        }
+        if(dst_levels != nullptr) {
+            updateSums(dst_levels + i, old_levels[i / 64], new_word);
+        }
+        new_levels[i / 64] = new_word;
+    }
+    return i;
+}
+
+unsigned int updateSimilarityLevelsNarrow(const unsigned char *src_1, unsigned int stride_1,
+                                          const unsigned char *src_2, unsigned int stride_2, unsigned int begin,
+                                          unsigned int end, int threshold, const uint64_t *old_levels,
+                                          uint64_t *new_levels, unsigned char *dst_levels)
+{
+    //difference of 2 unsigned chars is never bigger than 255, so bigger thresholds can be clipped
+    const __m256i v_threshold = _mm256_set1_epi8((char) (threshold < 255 ? threshold : 255));
+    unsigned int i = begin;
+    for(; i + 64 <= end; i += 64) {
+        uint64_t new_word = 0;
+        //2 lane groups per vector
+        for(unsigned int part = 0; part < 64; part += 2 * LANES) {
+            const unsigned int group = (i + part) / LANES;
+            __m256i a = loadGroups(src_1 + group * stride_1, src_1 + (group + 1) * stride_1);
+            __m256i b = loadGroups(src_2 + group * stride_2, src_2 + (group + 1) * stride_2);
+            __m256i diff = _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a));
+            __m256i similar = _mm256_cmpeq_epi8(_mm256_min_epu8(diff, v_threshold), diff);
+            new_word |= (uint64_t) (unsigned int) _mm256_movemask_epi8(similar) << part;
+        }
+        if(dst_levels != nullptr) {
+            updateSums(dst_levels + i, old_levels[i / 64], new_word);
+        }
+        new_levels[i / 64] = new_word;
+    }
+    return i;
+}
+
+unsigned int updateFlickerCounter(const uint64_t *flickering, unsigned int max_duration, unsigned int begin,
+                                  unsigned int end, unsigned char *flicker_counter, uint64_t *exceeded)
+{
+    //counters bigger than max_duration are the ones for which max(counter, max_duration + 1) is the counter
+    const __m256i v_min_exceeding = _mm256_set1_epi8((char) (max_duration + 1));
+    const __m256i v_one = _mm256_set1_epi8(1);
+    unsigned int i = begin;
+    for(; i + 64 <= end; i += 64) {
+        const uint64_t flickering_word = flickering[(i - begin) / 64];
+        uint64_t exceeded_word = 0;
+        for(unsigned int part = 0; part < 64; part += 32) {
+            __m256i counter = _mm256_loadu_si256((const __m256i *) (flicker_counter + i + part));
+            counter = _mm256_and_si256(_mm256_add_epi8(counter, v_one), expandFlags(flickering_word >> part));
+            _mm256_storeu_si256((__m256i *) (flicker_counter + i + part), counter);
+            __m256i over = _mm256_cmpeq_epi8(_mm256_max_epu8(counter, v_min_exceeding), counter);
+            exceeded_word |= (uint64_t) (unsigned int) _mm256_movemask_epi8(over) << part;
+        }
+        exceeded[(i - begin) / 64] = exceeded_word;
+    }
+    return i;
+}
+
+}
+
+const CPUKernelVariant avx2_kernel_variant = {"AVX2", applyMaskWide, applyMaskNarrow, updateSimilarityLevelsWide,
+                                              updateSimilarityLevelsNarrow, updateFlickerCounter};
+#else
+const CPUKernelVariant avx2_kernel_variant = {"AVX2", nullptr, nullptr, nullptr, nullptr, nullptr};
+#endif
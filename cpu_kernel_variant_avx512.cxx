@@ -0,0 +1,148 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#include "cpu_kernel_variant.hpp"
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+#include <immintrin.h>
+
+namespace {
+
+const unsigned int LANES = 16;
+
+/**
+ * @brief Loads 4 consecutive lane groups into one vector.
+ */
+__m512i loadGroups(const unsigned char *src, unsigned int group, unsigned int stride)
+{
+    __m512i groups = _mm512_castsi128_si512(_mm_loadu_si128((const __m128i *) (src + group * stride)));
+    groups = _mm512_inserti32x4(groups, _mm_loadu_si128((const __m128i *) (src + (group + 1) * stride)), 1);
+    groups = _mm512_inserti32x4(groups, _mm_loadu_si128((const __m128i *) (src + (group + 2) * stride)), 2);
+    return _mm512_inserti32x4(groups, _mm_loadu_si128((const __m128i *) (src + (group + 3) * stride)), 3);
+}
+
+unsigned int applyMaskWide(const unsigned char *src, const int *mask, unsigned int mask_stride, unsigned int begin,
+                           unsigned int end, int *dst, unsigned int dst_stride)
+{
+    unsigned int i = begin;
+    for(; i + LANES <= end; i += LANES) {
+        __m512i pixels = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *) (src + i)));
+        if(mask != nullptr) {
+            pixels = _mm512_sub_epi32(pixels, _mm512_loadu_si512(mask + i / LANES * mask_stride));
+        }
+        _mm512_storeu_si512(dst + i / LANES * dst_stride, pixels);
+    }
+    return i;
+}
+
+unsigned int applyMaskNarrow(const unsigned char *src, const short *mask, unsigned int mask_stride,
+                             unsigned int begin, unsigned int end, unsigned char *dst, unsigned int dst_stride)
+{
+    unsigned int i = begin;
+    //2 lane groups per vector of shorts
+    for(; i + 2 * LANES <= end; i += 2 * LANES) {
+        __m256i pixels = _mm256_loadu_si256((const __m256i *) (src + i));
+        unsigned char *dst_group_0 = dst + i / LANES * dst_stride;
+        unsigned char *dst_group_1 = dst_group_0 + dst_stride;
+        if(mask == nullptr) {
+            _mm_storeu_si128((__m128i *) dst_group_0, _mm256_castsi256_si128(pixels));
+            _mm_storeu_si128((__m128i *) dst_group_1, _mm256_extracti128_si256(pixels, 1));
+            continue;
+        }
+        const short *mask_group = mask + i / LANES * mask_stride;
+        __m512i masks = _mm512_inserti64x4(
+                _mm512_castsi256_si512(_mm256_loadu_si256((const __m256i *) mask_group)),
+                _mm256_loadu_si256((const __m256i *) (mask_group + mask_stride)), 1);
+        //saturating subtraction of shorts followed by unsigned saturation of non-negative values gives the same
+        //result as saturation of the exact difference
+        __m512i diff = _mm512_max_epi16(_mm512_subs_epi16(_mm512_cvtepu8_epi16(pixels), masks),
+                                        _mm512_setzero_si512());
+        __m256i packed = _mm512_cvtusepi16_epi8(diff);
+        _mm_storeu_si128((__m128i *) dst_group_0, _mm256_castsi256_si128(packed));
+        _mm_storeu_si128((__m128i *) dst_group_1, _mm256_extracti128_si256(packed, 1));
+    }
+    return i;
+}
+
+/**
+ * @brief Updates sums of levels of 64 pixels, adds 1 for similar pixels and subtracts 1 for previously similar ones.
+ */
+void updateSums(unsigned char *dst_levels, uint64_t old_word, uint64_t new_word)
+{
+    const __m512i v_one = _mm512_set1_epi8(1);
+    __m512i sum = _mm512_loadu_si512(dst_levels);
+    sum = _mm512_mask_add_epi8(sum, new_word, sum, v_one);
+    sum = _mm512_mask_sub_epi8(sum, old_word, sum, v_one);
+    _mm512_storeu_si512(dst_levels, sum);
+}
+
+unsigned int updateSimilarityLevelsWide(const int *src_1, unsigned int stride_1, const int *src_2,
+                                        unsigned int stride_2, unsigned int begin, unsigned int end, int threshold,
+                                        const uint64_t *old_levels, uint64_t *new_levels, unsigned char *dst_levels)
+{
+    const __m512i v_threshold = _mm512_set1_epi32(threshold);
+    unsigned int i = begin;
+    for(; i + 64 <= end; i += 64) {
+        uint64_t new_word = 0;
+        for(unsigned int part = 0; part < 64; part += LANES) {
+            __m512i a = _mm512_loadu_si512(src_1 + (i + part) / LANES * stride_1);
+            __m512i b = _mm512_loadu_si512(src_2 + (i + part) / LANES * stride_2);
+            //difference of the maximum and the minimum is the exact absolute difference as an unsigned int
+            __m512i diff = _mm512_sub_epi32(_mm512_max_epi32(a, b), _mm512_min_epi32(a, b));
+            new_word |= (uint64_t) _mm512_cmple_epu32_mask(diff, v_threshold) << part;
+        }
+        if(dst_levels != nullptr) {
+            updateSums(dst_levels + i, old_levels[i / 64], new_word);
+        }
+        new_levels[i / 64] = new_word;
+    }
+    return i;
+}
+
+unsigned int updateSimilarityLevelsNarrow(const unsigned char *src_1, unsigned int stride_1,
+                                          const unsigned char *src_2, unsigned int stride_2, unsigned int begin,
+                                          unsigned int end, int threshold, const uint64_t *old_levels,
+                                          uint64_t *new_levels, unsigned char *dst_levels)
+{
+    //difference of 2 unsigned chars is never bigger than 255, so bigger thresholds can be clipped
+    const __m512i v_threshold = _mm512_set1_epi8((char) (threshold < 255 ? threshold : 255));
+    unsigned int i = begin;
+    //4 lane groups per vector, so one comparison gives the whole word of flags
+    for(; i + 64 <= end; i += 64) {
+        __m512i a = loadGroups(src_1, i / LANES, stride_1);
+        __m512i b = loadGroups(src_2, i / LANES, stride_2);
+        __m512i diff = _mm512_or_si512(_mm512_subs_epu8(a, b), _mm512_subs_epu8(b, a));
+        uint64_t new_word = _mm512_cmple_epu8_mask(diff, v_threshold);
+        if(dst_levels != nullptr) {
+            updateSums(dst_levels + i, old_levels[i / 64], new_word);
+        }
+        new_levels[i / 64] = new_word;
+    }
+    return i;
+}
+
+unsigned int updateFlickerCounter(const uint64_t *flickering, unsigned int max_duration, unsigned int begin,
+                                  unsigned int end, unsigned char *flicker_counter, uint64_t *exceeded)
+{
+    const __m512i v_max_duration = _mm512_set1_epi8((char) max_duration);
+    const __m512i v_one = _mm512_set1_epi8(1);
+    unsigned int i = begin;
+    for(; i + 64 <= end; i += 64) {
+        //flickering pixels are counted, all other pixels have their counters zeroed
+        __m512i counter = _mm512_maskz_add_epi8(flickering[(i - begin) / 64],
+                                                _mm512_loadu_si512(flicker_counter + i), v_one);
+        _mm512_storeu_si512(flicker_counter + i, counter);
+        exceeded[(i - begin) / 64] = _mm512_cmpgt_epu8_mask(counter, v_max_duration);
+    }
+    return i;
+}
+
+}
+
+const CPUKernelVariant avx512_kernel_variant = {"AVX-512", applyMaskWide, applyMaskNarrow,
+                                                updateSimilarityLevelsWide, updateSimilarityLevelsNarrow,
+                                                updateFlickerCounter};
+#else
+const CPUKernelVariant avx512_kernel_variant = {"AVX-512", nullptr, nullptr, nullptr, nullptr, nullptr};
+#endif
@@ -0,0 +1,175 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#include "cpu_kernel_variant.hpp"
+
+#if defined(__SSE4_2__)
+#include <immintrin.h>
+
+namespace {
+
+const unsigned int LANES = 16;
+
+/**
+ * @brief Expands 16 lowest bits of the word of flags into a vector of bytes with values 0xFF or 0.
+ */
+__m128i expandFlags(uint64_t flags)
+{
+    const __m128i shuffle = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1);
+    const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    __m128i bytes = _mm_shuffle_epi8(_mm_cvtsi32_si128((int) (flags & 0xFFFFU)), shuffle);
+    return _mm_cmpeq_epi8(_mm_and_si128(bytes, bits), bits);
+}
+
+/**
+ * @brief Absolute differences of ints as unsigned ints, compared with the threshold.
+ * @return Vector with all ones for similar pixels and 0 for other pixels.
+ */
+__m128i similarInts(const int *src_1, const int *src_2, __m128i threshold)
+{
+    __m128i a = _mm_loadu_si128((const __m128i *) src_1);
+    __m128i b = _mm_loadu_si128((const __m128i *) src_2);
+    __m128i diff = _mm_sub_epi32(_mm_max_epi32(a, b), _mm_min_epi32(a, b));
+    return _mm_cmpeq_epi32(_mm_min_epu32(diff, threshold), diff);
+}
+
+unsigned int applyMaskWide(const unsigned char *src, const int *mask, unsigned int mask_stride, unsigned int begin,
+                           unsigned int end, int *dst, unsigned int dst_stride)
+{
+    unsigned int i = begin;
+    for(; i + LANES <= end; i += LANES) {
+        __m128i pixels = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i dst_0 = _mm_cvtepu8_epi32(pixels);
+        __m128i dst_1 = _mm_cvtepu8_epi32(_mm_srli_si128(pixels, 4));
+        __m128i dst_2 = _mm_cvtepu8_epi32(_mm_srli_si128(pixels, 8));
+        __m128i dst_3 = _mm_cvtepu8_epi32(_mm_srli_si128(pixels, 12));
+        if(mask != nullptr) {
+            const int *mask_group = mask + i / LANES * mask_stride;
+            dst_0 = _mm_sub_epi32(dst_0, _mm_loadu_si128((const __m128i *) mask_group));
+            dst_1 = _mm_sub_epi32(dst_1, _mm_loadu_si128((const __m128i *) (mask_group + 4)));
+            dst_2 = _mm_sub_epi32(dst_2, _mm_loadu_si128((const __m128i *) (mask_group + 8)));
+            dst_3 = _mm_sub_epi32(dst_3, _mm_loadu_si128((const __m128i *) (mask_group + 12)));
+        }
+        int *dst_group = dst + i / LANES * dst_stride;
+        _mm_storeu_si128((__m128i *) dst_group, dst_0);
+        _mm_storeu_si128((__m128i *) (dst_group + 4), dst_1);
+        _mm_storeu_si128((__m128i *) (dst_group + 8), dst_2);
+        _mm_storeu_si128((__m128i *) (dst_group + 12), dst_3);
+    }
+    return i;
+}
+
+unsigned int applyMaskNarrow(const unsigned char *src, const short *mask, unsigned int mask_stride,
+                             unsigned int begin, unsigned int end, unsigned char *dst, unsigned int dst_stride)
+{
+    unsigned int i = begin;
+    for(; i + LANES <= end; i += LANES) {
+        __m128i pixels = _mm_loadu_si128((const __m128i *) (src + i));
+        unsigned char *dst_group = dst + i / LANES * dst_stride;
+        if(mask == nullptr) {
+            _mm_storeu_si128((__m128i *) dst_group, pixels);
+            continue;
+        }
+        const short *mask_group = mask + i / LANES * mask_stride;
+        __m128i dst_lo = _mm_subs_epi16(_mm_cvtepu8_epi16(pixels), _mm_loadu_si128((const __m128i *) mask_group));
+        __m128i dst_hi = _mm_subs_epi16(_mm_unpackhi_epi8(pixels, _mm_setzero_si128()),
+                                        _mm_loadu_si128((const __m128i *) (mask_group + 8)));
+        _mm_storeu_si128((__m128i *) dst_group, _mm_packus_epi16(dst_lo, dst_hi));
+    }
+    return i;
+}
+
+/**
+ * @brief Updates sums of levels of 64 pixels. Flags are all ones for 0xFF bytes, so subtracting new flags and adding
+ * old ones adds 1 for similar pixels and subtracts 1 for previously similar ones.
+ */
+void updateSums(unsigned char *dst_levels, uint64_t old_word, uint64_t new_word)
+{
+    for(unsigned int part = 0; part < 64; part += LANES) {
+        __m128i sum = _mm_loadu_si128((const __m128i *) (dst_levels + part));
+        sum = _mm_add_epi8(_mm_sub_epi8(sum, expandFlags(new_word >> part)), expandFlags(old_word >> part));
+        _mm_storeu_si128((__m128i *) (dst_levels + part), sum);
+    }
+}
+
+unsigned int updateSimilarityLevelsWide(const int *src_1, unsigned int stride_1, const int *src_2,
+                                        unsigned int stride_2, unsigned int begin, unsigned int end, int threshold,
+                                        const uint64_t *old_levels, uint64_t *new_levels, unsigned char *dst_levels)
+{
+    const __m128i v_threshold = _mm_set1_epi32(threshold);
+    unsigned int i = begin;
+    for(; i + 64 <= end; i += 64) {
+        uint64_t new_word = 0;
+        for(unsigned int part = 0; part < 64; part += LANES) {
+            const int *group_1 = src_1 + (i + part) / LANES * stride_1;
+            const int *group_2 = src_2 + (i + part) / LANES * stride_2;
+            //comparison results are all ones or all zeros, so saturating packing keeps them as 0xFF or 0
+            __m128i similar_lo = _mm_packs_epi32(similarInts(group_1, group_2, v_threshold),
+                                                 similarInts(group_1 + 4, group_2 + 4, v_threshold));
+            __m128i similar_hi = _mm_packs_epi32(similarInts(group_1 + 8, group_2 + 8, v_threshold),
+                                                 similarInts(group_1 + 12, group_2 + 12, v_threshold));
+            new_word |= (uint64_t) (unsigned int) _mm_movemask_epi8(_mm_packs_epi16(similar_lo, similar_hi)) << part;
+        }
+        if(dst_levels != nullptr) {
+            updateSums(dst_levels + i, old_levels[i / 64], new_word);
+        }
+        new_levels[i / 64] = new_word;
+    }
+    return i;
+}
+
+unsigned int updateSimilarityLevelsNarrow(const unsigned char *src_1, unsigned int stride_1,
+                                          const unsigned char *src_2, unsigned int stride_2, unsigned int begin,
+                                          unsigned int end, int threshold, const uint64_t *old_levels,
+                                          uint64_t *new_levels, unsigned char *dst_levels)
+{
+    //difference of 2 unsigned chars is never bigger than 255, so bigger thresholds can be clipped
+    const __m128i v_threshold = _mm_set1_epi8((char) (threshold < 255 ? threshold : 255));
+    unsigned int i = begin;
+    for(; i + 64 <= end; i += 64) {
+        uint64_t new_word = 0;
+        for(unsigned int part = 0; part < 64; part += LANES) {
+            __m128i a = _mm_loadu_si128((const __m128i *) (src_1 + (i + part) / LANES * stride_1));
+            __m128i b = _mm_loadu_si128((const __m128i *) (src_2 + (i + part) / LANES * stride_2));
+            __m128i diff = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+            __m128i similar = _mm_cmpeq_epi8(_mm_min_epu8(diff, v_threshold), diff);
+            new_word |= (uint64_t) (unsigned int) _mm_movemask_epi8(similar) << part;
+        }
+        if(dst_levels != nullptr) {
+            updateSums(dst_levels + i, old_levels[i / 64], new_word);
+        }
+        new_levels[i / 64] = new_word;
+    }
+    return i;
+}
+
+unsigned int updateFlickerCounter(const uint64_t *flickering, unsigned int max_duration, unsigned int begin,
+                                  unsigned int end, unsigned char *flicker_counter, uint64_t *exceeded)
+{
+    //counters bigger than max_duration are the ones for which max(counter, max_duration + 1) is the counter
+    const __m128i v_min_exceeding = _mm_set1_epi8((char) (max_duration + 1));
+    const __m128i v_one = _mm_set1_epi8(1);
+    unsigned int i = begin;
+    for(; i + 64 <= end; i += 64) {
+        const uint64_t flickering_word = flickering[(i - begin) / 64];
+        uint64_t exceeded_word = 0;
+        for(unsigned int part = 0; part < 64; part += LANES) {
+            __m128i counter = _mm_loadu_si128((const __m128i *) (flicker_counter + i + part));
+            counter = _mm_and_si128(_mm_add_epi8(counter, v_one), expandFlags(flickering_word >> part));
+            _mm_storeu_si128((__m128i *) (flicker_counter + i + part), counter);
+            __m128i over = _mm_cmpeq_epi8(_mm_max_epu8(counter, v_min_exceeding), counter);
+            exceeded_word |= (uint64_t) (unsigned int) _mm_movemask_epi8(over) << part;
+        }
+        exceeded[(i - begin) / 64] = exceeded_word;
+    }
+    return i;
+}
+
+}
+
+const CPUKernelVariant sse42_kernel_variant = {"SSE4.2", applyMaskWide, applyMaskNarrow, updateSimilarityLevelsWide,
+                                               updateSimilarityLevelsNarrow, updateFlickerCounter};
+#else
+const CPUKernelVariant sse42_kernel_variant = {"SSE4.2", nullptr, nullptr, nullptr, nullptr, nullptr};
+#endif
@@ -0,0 +1,510 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#include "cpu_kernels.hpp"
+#include "cpu_kernel_variant.hpp"
+#include <opencv2/core.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+using namespace cv;
+
+
+namespace {
+
+/**
+ * @brief Table expanding one byte of words of flags into 8 bytes with values 0 or 1. Byte <b>k</b> of the row is equal
+ * to bit <b>k</b> of the index.
+ */
+struct BitExpansionTable {
+    unsigned char bytes[256][8];
+
+    BitExpansionTable()
+    {
+        for(unsigned int value = 0; value < 256; value++) {
+            for(unsigned int bit = 0; bit < 8; bit++) {
+                bytes[value][bit] = (unsigned char) ((value >> bit) & 1U);
+            }
+        }
+    }
+};
+
+const BitExpansionTable bit_expansion;
+
+/**
+ * @brief Variant of kernels used when the processor supports none of the x86 variants. Everything is done by
+ * universal intrinsics and scalar code.
+ */
+const CPUKernelVariant baseline_kernel_variant = {"baseline", nullptr, nullptr, nullptr, nullptr, nullptr};
+
+/**
+ * @brief Returns the best variant of kernels compiled for this platform and supported by the processor. It is
+ * selected once, on the first call.
+ */
+const CPUKernelVariant &kernelVariant()
+{
+    static const CPUKernelVariant &variant = []() -> const CPUKernelVariant & {
+        if(avx512_kernel_variant.update_flicker_counter != nullptr && checkHardwareSupport(CV_CPU_AVX_512F) &&
+           checkHardwareSupport(CV_CPU_AVX_512BW)) {
+            return avx512_kernel_variant;
+        }
+        if(avx2_kernel_variant.update_flicker_counter != nullptr && checkHardwareSupport(CV_CPU_AVX2)) {
+            return avx2_kernel_variant;
+        }
+        if(sse42_kernel_variant.update_flicker_counter != nullptr && checkHardwareSupport(CV_CPU_SSE4_2)) {
+            return sse42_kernel_variant;
+        }
+        return baseline_kernel_variant;
+    }();
+    return variant;
+}
+
+#if CV_SIMD128
+/**
+ * @brief Expands 16 lowest bits of the word of flags into a vector of bytes with values 0 or 1.
+ */
+inline v_uint8x16 expandFlags(uint64_t flags)
+{
+    unsigned char bytes[16];
+    std::memcpy(bytes, bit_expansion.bytes[flags & 0xFFU], 8);
+    std::memcpy(bytes + 8, bit_expansion.bytes[(flags >> 8) & 0xFFU], 8);
+    return v_load(bytes);
+}
+
+/**
+ * @brief Compares 16 consecutive pixels of 2 frames. Threshold must not be negative.
+ */
+template<typename PixelT>
+struct SimilarityTest;
+
+template<>
+struct SimilarityTest<int> {
+    v_uint32x4 threshold;
+
+    explicit SimilarityTest(int threshold) : threshold(v_setall_u32((unsigned int) threshold))
+    {}
+
+    /**
+     * @return Vector with 0xFF for similar pixels and 0 for other pixels.
+     */
+    v_uint8x16 operator()(const int *src_1, const int *src_2) const
+    {
+        v_uint32x4 similar_0 = v_absdiff(v_load(src_1), v_load(src_2)) <= threshold;
+        v_uint32x4 similar_1 = v_absdiff(v_load(src_1 + 4), v_load(src_2 + 4)) <= threshold;
+        v_uint32x4 similar_2 = v_absdiff(v_load(src_1 + 8), v_load(src_2 + 8)) <= threshold;
+        v_uint32x4 similar_3 = v_absdiff(v_load(src_1 + 12), v_load(src_2 + 12)) <= threshold;
+        //comparison results are all ones or all zeros, so saturating packing keeps them as 0xFF or 0
+        return v_pack(v_pack(similar_0, similar_1), v_pack(similar_2, similar_3));
+    }
+};
+
+template<>
+struct SimilarityTest<unsigned char> {
+    v_uint8x16 threshold;
+
+    //difference of 2 unsigned chars is never bigger than 255, so bigger thresholds can be clipped
+    explicit SimilarityTest(int threshold) : threshold(v_setall_u8((unsigned char) std::min(threshold, 255)))
+    {}
+
+    /**
+     * @return Vector with 0xFF for similar pixels and 0 for other pixels.
+     */
+    v_uint8x16 operator()(const unsigned char *src_1, const unsigned char *src_2) const
+    {
+        return v_absdiff(v_load(src_1), v_load(src_2)) <= threshold;
+    }
+};
+#endif
+
+/**
+ * @brief Scalar version of <b>CPUKernels::applyMask()</b>. Wide results are not saturated, because saturate_cast to
+ * int does not change int values.
+ */
+template<typename PixelT, typename MaskT>
+void applyMaskImpl(const unsigned char *src, PixelPlane<const MaskT> mask, unsigned int begin, unsigned int end,
+                   PixelPlane<PixelT> dst)
+{
+    if(mask.data != nullptr) {
+        for(unsigned int i = begin; i < end; i++) {
+            dst[i] = saturate_cast<PixelT>((int) src[i] - mask[i]);
+        }
+    } else {
+        for(unsigned int i = begin; i < end; i++) {
+            dst[i] = (PixelT) src[i];
+        }
+    }
+}
+
+template<typename PixelT>
+void copyFrameImpl(PixelPlane<const PixelT> src, unsigned int begin, unsigned int end, PixelT *dst)
+{
+    if(src.group_stride == PixelPlane<const PixelT>::LANES) {
+        std::memcpy(dst + begin, src.ptr(begin), (end - begin) * sizeof(PixelT));
+        return;
+    }
+    unsigned int i = begin;
+    while(i < end) {
+        unsigned int group_end = std::min(end, (i / PixelPlane<const PixelT>::LANES + 1) *
+                                               PixelPlane<const PixelT>::LANES);
+        std::memcpy(dst + i, src.ptr(i), (group_end - i) * sizeof(PixelT));
+        i = group_end;
+    }
+}
+
+template<typename PixelT>
+void updateSimilarityLevelsImpl(PixelPlane<const PixelT> src_1, PixelPlane<const PixelT> src_2, unsigned int begin,
+                                unsigned int end, int threshold, const uint64_t *old_levels, uint64_t *new_levels,
+                                unsigned char *dst_levels)
+{
+    unsigned int i = begin;
+#if CV_SIMD128
+    //negative threshold would wrap around in unsigned comparisons, no pixels are similar then, so leave it for the
+    //scalar code
+    if(threshold >= 0) {
+        const SimilarityTest<PixelT> similar16(threshold);
+        const v_uint8x16 v_one = v_setall_u8(1);
+        //one word of flags (64 pixels) per iteration
+        for(; i + 64 <= end; i += 64) {
+            const uint64_t old_word = old_levels[i / 64];
+            uint64_t new_word = 0;
+            for(unsigned int part = 0; part < 64; part += 16) {
+                //begin is a multiple of 64, so every part is one lane group
+                v_uint8x16 similar = similar16(src_1.ptr(i + part), src_2.ptr(i + part));
+                new_word |= (uint64_t) (unsigned int) v_signmask(similar) << part;
+
+                if(dst_levels == nullptr) {
+                    continue;
+                }
+                v_uint8x16 sum = v_load(dst_levels + i + part);
+                sum = v_sub_wrap(v_add_wrap(sum, similar & v_one), expandFlags(old_word >> part));
+                v_store(dst_levels + i + part, sum);
+            }
+            new_levels[i / 64] = new_word;
+        }
+    }
+#endif
+    for(; i < end; i++) {
+        uint64_t bit = (uint64_t) 1 << (i % 64);
+        bool pixels_are_similar = std::abs((int) src_1[i] - (int) src_2[i]) <= threshold;
+        bool was_similar = (old_levels[i / 64] & bit) != 0;
+        if(pixels_are_similar) {
+            new_levels[i / 64] |= bit;
+        } else {
+            new_levels[i / 64] &= ~bit;
+        }
+        if(dst_levels != nullptr) {
+            dst_levels[i] += (unsigned char) pixels_are_similar - (unsigned char) was_similar;
+        }
+    }
+}
+
+/**
+ * @brief Block sizes for which the end of block step is specialized at compile time. They are block sizes of cameras
+ * with 100, 150, 200 and 250 fps.
+ */
+const unsigned int MIN_SPECIALIZED_BLOCK_SIZE = 2;
+const unsigned int MAX_SPECIALIZED_BLOCK_SIZE = 5;
+
+/**
+ * @brief Refines masks of one pixel, zeroes its flicker counter and applies the new mask to the last frame of the
+ * block if it is given. See <b>CPUKernels::updateFlickerCounter()</b> for the description of parameters.
+ * @tparam BLOCK_SIZE Number of frames in the block known at compile time, so loops over frames and masks are fully
+ * unrolled, or 0 if <b>block_size</b> is used.
+ */
+template<unsigned int BLOCK_SIZE, typename PixelT, typename MaskT>
+void refineMasks(const PixelPlane<const PixelT> *frames, unsigned int block_size, const PixelPlane<MaskT> *masks,
+                 unsigned int index, unsigned char *flicker_counter, PixelPlane<PixelT> last_frame)
+{
+    const unsigned int size = BLOCK_SIZE != 0 ? BLOCK_SIZE : block_size;
+    const int first_frame_val = frames[0][index];
+    for(unsigned int i = 0; i + 1 < size; i++) {
+        masks[i][index] = saturate_cast<MaskT>(masks[i][index] + frames[i + 1][index] - first_frame_val);
+    }
+    flicker_counter[index] = 0;
+    if(last_frame.data == nullptr) {
+        return;
+    }
+    //subtract mask from the last frame, but be sure that result is between 0-255
+    int mask_val = masks[size - 2][index];
+    int frame_val = last_frame[index];
+    if(mask_val >= 0) {
+        if(frame_val >= mask_val) {
+            frame_val -= mask_val;
+        } else {
+            frame_val = 0;
+        }
+    } else {
+        if(frame_val - mask_val > 255) {
+            frame_val = 255;
+        } else {
+            frame_val -= mask_val;
+        }
+    }
+    last_frame[index] = saturate_cast<PixelT>(frame_val);
+}
+
+template<unsigned int BLOCK_SIZE, typename PixelT, typename MaskT>
+void updateFlickerCounterImpl(const PixelPlane<const PixelT> *frames, unsigned int block_size,
+                              const PixelPlane<MaskT> *masks, const uint64_t *flickering, int max_duration,
+                              unsigned int begin, unsigned int end, unsigned char *flicker_counter,
+                              PixelPlane<PixelT> last_frame, uint64_t *refined)
+{
+    //counters of the whole range are updated first and masks of pixels which counters were exceeded are refined
+    //afterwards, so the hot loop does not depend on the block size and can use the widest vectors
+    const unsigned int number_of_words = (end - begin + 63) / 64;
+    AutoBuffer<uint64_t, 64> exceeded_buffer(refined != nullptr ? 0 : number_of_words);
+    uint64_t *exceeded = refined != nullptr ? refined : exceeded_buffer.data();
+    std::memset(exceeded, 0, number_of_words * sizeof(uint64_t));
+
+    unsigned int i = begin;
+    //vectorized comparisons work on unsigned char values, unusual parameters are left for the scalar code
+    if(max_duration >= 0 && max_duration < 255) {
+        const CPUKernelVariant &variant = kernelVariant();
+        if(variant.update_flicker_counter != nullptr) {
+            i = variant.update_flicker_counter(flickering, (unsigned int) max_duration, begin, end, flicker_counter,
+                                               exceeded);
+        }
+#if CV_SIMD128
+        const v_uint8x16 v_max_duration = v_setall_u8((unsigned char) max_duration);
+        const v_uint8x16 v_one = v_setall_u8(1);
+        const v_uint8x16 v_zero = v_setzero_u8();
+        for(; i + 16 <= end; i += 16) {
+            uint64_t flickering_flags = flickering[(i - begin) / 64] >> ((i - begin) % 64);
+            if((flickering_flags & 0xFFFFU) == 0) {
+                v_store(flicker_counter + i, v_zero);
+                continue;
+            }
+            //flickering pixels are counted, all other pixels have their counters zeroed
+            v_uint8x16 counter = v_add_wrap(v_load(flicker_counter + i), v_one);
+            counter = v_select(expandFlags(flickering_flags) > v_zero, counter, v_zero);
+            v_store(flicker_counter + i, counter);
+            int bits = v_signmask(counter > v_max_duration);
+            exceeded[(i - begin) / 64] |= (uint64_t) (unsigned int) bits << ((i - begin) % 64);
+        }
+#endif
+    }
+    for(; i < end; i++) {
+        unsigned char &value = flicker_counter[i];
+        if(((flickering[(i - begin) / 64] >> ((i - begin) % 64)) & 1U) != 0) {
+            value++;
+        } else {
+            value = 0;
+        }
+        if(value > max_duration) {
+            exceeded[(i - begin) / 64] |= (uint64_t) 1 << ((i - begin) % 64);
+        }
+    }
+
+    for(unsigned int j = 0; j < number_of_words; j++) {
+        uint64_t word = exceeded[j];
+        while(word != 0) {
+            unsigned int index = begin + j * 64 + (unsigned int) __builtin_ctzll(word);
+            refineMasks<BLOCK_SIZE>(frames, block_size, masks, index, flicker_counter, last_frame);
+            word &= word - 1;
+        }
+    }
+}
+
+/**
+ * @brief Runs <b>updateFlickerCounterImpl()</b> specialized for the block size if there is such specialization, or
+ * the generic version otherwise.
+ */
+template<unsigned int BLOCK_SIZE, typename PixelT, typename MaskT>
+void dispatchUpdateFlickerCounter(const PixelPlane<const PixelT> *frames, unsigned int block_size,
+                                  const PixelPlane<MaskT> *masks, const uint64_t *flickering, int max_duration,
+                                  unsigned int begin, unsigned int end, unsigned char *flicker_counter,
+                                  PixelPlane<PixelT> last_frame, uint64_t *refined)
+{
+    if(block_size == BLOCK_SIZE) {
+        updateFlickerCounterImpl<BLOCK_SIZE>(frames, block_size, masks, flickering, max_duration, begin, end,
+                                             flicker_counter, last_frame, refined);
+    } else if constexpr(BLOCK_SIZE < MAX_SPECIALIZED_BLOCK_SIZE) {
+        dispatchUpdateFlickerCounter<BLOCK_SIZE + 1>(frames, block_size, masks, flickering, max_duration, begin, end,
+                                                     flicker_counter, last_frame, refined);
+    } else {
+        updateFlickerCounterImpl<0>(frames, block_size, masks, flickering, max_duration, begin, end,
+                                    flicker_counter, last_frame, refined);
+    }
+}
+
+}
+
+void CPUKernels::applyMask(const unsigned char *src, PixelPlane<const int> mask, unsigned int begin,
+                           unsigned int end, PixelPlane<int> dst)
+{
+    unsigned int i = begin;
+#if CV_SIMD128
+    //vectors must not cross lane groups, so pixels before the first whole group are left for the scalar code
+    const unsigned int head_end = std::min(end, (begin + PixelPlane<int>::LANES - 1) / PixelPlane<int>::LANES *
+                                                PixelPlane<int>::LANES);
+    applyMaskImpl(src, mask, i, head_end, dst);
+    i = head_end;
+    const CPUKernelVariant &variant = kernelVariant();
+    if(variant.apply_mask_wide != nullptr) {
+        i = variant.apply_mask_wide(src, mask.data, mask.group_stride, i, end, dst.data, dst.group_stride);
+    }
+    for(; i + 16 <= end; i += 16) {
+        v_uint16x8 src_lo, src_hi;
+        v_expand(v_load(src + i), src_lo, src_hi);
+        v_uint32x4 src_0, src_1, src_2, src_3;
+        v_expand(src_lo, src_0, src_1);
+        v_expand(src_hi, src_2, src_3);
+        v_int32x4 dst_0 = v_reinterpret_as_s32(src_0);
+        v_int32x4 dst_1 = v_reinterpret_as_s32(src_1);
+        v_int32x4 dst_2 = v_reinterpret_as_s32(src_2);
+        v_int32x4 dst_3 = v_reinterpret_as_s32(src_3);
+        if(mask.data != nullptr) {
+            const int *mask_group = mask.ptr(i);
+            dst_0 = dst_0 - v_load(mask_group);
+            dst_1 = dst_1 - v_load(mask_group + 4);
+            dst_2 = dst_2 - v_load(mask_group + 8);
+            dst_3 = dst_3 - v_load(mask_group + 12);
+        }
+        int *dst_group = dst.ptr(i);
+        v_store(dst_group, dst_0);
+        v_store(dst_group + 4, dst_1);
+        v_store(dst_group + 8, dst_2);
+        v_store(dst_group + 12, dst_3);
+    }
+#endif
+    applyMaskImpl(src, mask, i, end, dst);
+}
+
+void CPUKernels::applyMask(const unsigned char *src, PixelPlane<const short> mask, unsigned int begin,
+                           unsigned int end, PixelPlane<unsigned char> dst)
+{
+    unsigned int i = begin;
+#if CV_SIMD128
+    //vectors must not cross lane groups, so pixels before the first whole group are left for the scalar code
+    const unsigned int head_end = std::min(end, (begin + PixelPlane<unsigned char>::LANES - 1) /
+                                                PixelPlane<unsigned char>::LANES * PixelPlane<unsigned char>::LANES);
+    applyMaskImpl(src, mask, i, head_end, dst);
+    i = head_end;
+    const CPUKernelVariant &variant = kernelVariant();
+    if(variant.apply_mask_narrow != nullptr) {
+        i = variant.apply_mask_narrow(src, mask.data, mask.group_stride, i, end, dst.data, dst.group_stride);
+    }
+    for(; i + 16 <= end; i += 16) {
+        if(mask.data == nullptr) {
+            v_store(dst.ptr(i), v_load(src + i));
+            continue;
+        }
+        v_uint16x8 src_lo, src_hi;
+        v_expand(v_load(src + i), src_lo, src_hi);
+        //saturating subtraction of shorts followed by saturating packing gives the same result as saturation of the
+        //exact difference
+        const short *mask_group = mask.ptr(i);
+        v_int16x8 dst_lo = v_reinterpret_as_s16(src_lo) - v_load(mask_group);
+        v_int16x8 dst_hi = v_reinterpret_as_s16(src_hi) - v_load(mask_group + 8);
+        v_store(dst.ptr(i), v_pack_u(dst_lo, dst_hi));
+    }
+#endif
+    applyMaskImpl(src, mask, i, end, dst);
+}
+
+void CPUKernels::copyFrame(PixelPlane<const int> src, unsigned int begin, unsigned int end, int *dst)
+{
+    copyFrameImpl(src, begin, end, dst);
+}
+
+void CPUKernels::copyFrame(PixelPlane<const unsigned char> src, unsigned int begin, unsigned int end,
+                           unsigned char *dst)
+{
+    copyFrameImpl(src, begin, end, dst);
+}
+
+void CPUKernels::updateSimilarityLevels(PixelPlane<const int> src_1, PixelPlane<const int> src_2, unsigned int begin,
+                                        unsigned int end, int threshold, const uint64_t *old_levels,
+                                        uint64_t *new_levels, unsigned char *dst_levels)
+{
+    unsigned int i = begin;
+    const CPUKernelVariant &variant = kernelVariant();
+    if(variant.update_similarity_levels_wide != nullptr && threshold >= 0) {
+        i = variant.update_similarity_levels_wide(src_1.data, src_1.group_stride, src_2.data, src_2.group_stride, i,
+                                                  end, threshold, old_levels, new_levels, dst_levels);
+    }
+    updateSimilarityLevelsImpl(src_1, src_2, i, end, threshold, old_levels, new_levels, dst_levels);
+}
+
+void CPUKernels::updateSimilarityLevels(PixelPlane<const unsigned char> src_1, PixelPlane<const unsigned char> src_2,
+                                        unsigned int begin, unsigned int end, int threshold,
+                                        const uint64_t *old_levels, uint64_t *new_levels, unsigned char *dst_levels)
+{
+    unsigned int i = begin;
+    const CPUKernelVariant &variant = kernelVariant();
+    if(variant.update_similarity_levels_narrow != nullptr && threshold >= 0) {
+        i = variant.update_similarity_levels_narrow(src_1.data, src_1.group_stride, src_2.data, src_2.group_stride, i,
+                                                    end, threshold, old_levels, new_levels, dst_levels);
+    }
+    updateSimilarityLevelsImpl(src_1, src_2, i, end, threshold, old_levels, new_levels, dst_levels);
+}
+
+void CPUKernels::findCandidates(const unsigned char *corresponding_sum, unsigned int min_similar_blocks,
+                                unsigned int begin, unsigned int end, uint64_t *candidates)
+{
+    std::memset(candidates, 0, (end - begin + 63) / 64 * sizeof(uint64_t));
+    if(min_similar_blocks > 255) {
+        return;
+    }
+    unsigned int i = begin;
+#if CV_SIMD128
+    const v_uint8x16 v_min_similar_blocks = v_setall_u8((unsigned char) min_similar_blocks);
+    for(; i + 16 <= end; i += 16) {
+        int bits = v_signmask(v_load(corresponding_sum + i) >= v_min_similar_blocks);
+        candidates[(i - begin) / 64] |= (uint64_t) (unsigned int) bits << ((i - begin) % 64);
+    }
+#endif
+    for(; i < end; i++) {
+        if(corresponding_sum[i] >= min_similar_blocks) {
+            candidates[(i - begin) / 64] |= (uint64_t) 1 << ((i - begin) % 64);
+        }
+    }
+}
+
+void CPUKernels::findStaticPixels(const unsigned char *adjacent_sum, unsigned int number_of_pairs, unsigned int begin,
+                                  unsigned int end, uint64_t *static_pixels)
+{
+    std::memset(static_pixels, 0, (end - begin + 63) / 64 * sizeof(uint64_t));
+    if(number_of_pairs > 255) {
+        return;
+    }
+    unsigned int i = begin;
+#if CV_SIMD128
+    const v_uint8x16 v_number_of_pairs = v_setall_u8((unsigned char) number_of_pairs);
+    for(; i + 16 <= end; i += 16) {
+        int bits = v_signmask(v_load(adjacent_sum + i) == v_number_of_pairs);
+        static_pixels[(i - begin) / 64] |= (uint64_t) (unsigned int) bits << ((i - begin) % 64);
+    }
+#endif
+    for(; i < end; i++) {
+        if(adjacent_sum[i] == number_of_pairs) {
+            static_pixels[(i - begin) / 64] |= (uint64_t) 1 << ((i - begin) % 64);
+        }
+    }
+}
+
+void CPUKernels::updateFlickerCounter(const PixelPlane<const int> *frames, unsigned int block_size,
+                                      const PixelPlane<int> *masks, const uint64_t *flickering, int max_duration,
+                                      unsigned int begin, unsigned int end, unsigned char *flicker_counter,
+                                      PixelPlane<int> last_frame, uint64_t *refined)
+{
+    dispatchUpdateFlickerCounter<MIN_SPECIALIZED_BLOCK_SIZE>(frames, block_size, masks, flickering, max_duration,
+                                                             begin, end, flicker_counter, last_frame, refined);
+}
+
+void CPUKernels::updateFlickerCounter(const PixelPlane<const unsigned char> *frames, unsigned int block_size,
+                                      const PixelPlane<short> *masks, const uint64_t *flickering, int max_duration,
+                                      unsigned int begin, unsigned int end, unsigned char *flicker_counter,
+                                      PixelPlane<unsigned char> last_frame, uint64_t *refined)
+{
+    dispatchUpdateFlickerCounter<MIN_SPECIALIZED_BLOCK_SIZE>(frames, block_size, masks, flickering, max_duration,
+                                                             begin, end, flicker_counter, last_frame, refined);
+}
+
+const char *CPUKernels::getInstructionSet()
+{
+    return kernelVariant().name;
+}
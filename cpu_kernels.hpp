@@ -0,0 +1,194 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#ifndef CPU_KERNELS_HPP
+#define CPU_KERNELS_HPP
+
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * @brief Pointer to pixels of one frame or mask which may be interleaved with other frames. Pixels are split into lane
+ * groups of <b>LANES</b> consecutive pixels. Pixels of one group are stored next to each other and consecutive groups
+ * are <b>group_stride</b> elements apart, so the pixel with linear index <b>i</b> is stored at
+ * <b>data[i / LANES * group_stride + i % LANES]</b>. Continuous frames have <b>group_stride</b> equal to <b>LANES</b>.
+ * If groups of all frames of the block are stored one after another, all samples of the pixel are in a few adjacent
+ * cache lines.
+ * @tparam T Type of pixels.
+ */
+template<typename T>
+struct PixelPlane {
+    /**
+     * @brief Number of pixels in one lane group. It is the number of unsigned char lanes of 128-bit vectors.
+     */
+    static constexpr unsigned int LANES = 16;
+
+    /**
+     * @brief First pixel of the plane or nullptr if there is no plane.
+     */
+    T *data;
+
+    /**
+     * @brief Distance in elements between first pixels of consecutive lane groups.
+     */
+    unsigned int group_stride;
+
+    PixelPlane(T *data = nullptr, unsigned int group_stride = LANES) : data(data), group_stride(group_stride)
+    {}
+
+    /**
+     * @brief Converts plane of non-const pixels to plane of const pixels.
+     */
+    template<typename U, typename = typename std::enable_if<std::is_convertible<U *, T *>::value>::type>
+    PixelPlane(const PixelPlane<U> &plane) : data(plane.data), group_stride(plane.group_stride)
+    {}
+
+    /**
+     * @brief Returns pointer to the pixel. Pixels up to the end of its lane group follow it in memory.
+     * @param index Linear index of the pixel.
+     */
+    T *ptr(unsigned int index) const
+    {
+        return data + index / LANES * group_stride + index % LANES;
+    }
+
+    T &operator[](unsigned int index) const
+    {
+        return *ptr(index);
+    }
+};
+
+/**
+ * @brief Helper class containing vectorized per-pixel algorithms used by FlickerRemoverCPU. It is the CPU counterpart
+ * of OpenCLKernels. All algorithms walk planes of pixels lane group after lane group and use OpenCV universal
+ * intrinsics, so the same code is compiled to SSE, NEON or VSX instructions depending on the platform. Pixels that do
+ * not fill the whole vector at the end of the range are processed by scalar code giving exactly the same results.
+ *
+ * Every algorithm processes pixels with linear indexes (row * cols + col) from range [begin, end), so the caller can
+ * split frames into tiles and run all algorithms on one tile while it is still in cache. For algorithms using packed
+ * similarity flags begin of the range must be a multiple of 64. Packed similarity flags are stored in the format used
+ * by BooleanArray2D: flag of the pixel with linear index <b>i</b> is stored as bit <b>i % 64</b> of 64-bit word
+ * <b>i / 64</b>.
+ *
+ * Frames and masks are passed as PixelPlane, so they can be continuous planes or slots of history in which samples of
+ * the same pixels from different frames are interleaved. Vectors never cross lane groups.
+ *
+ * Every algorithm has 2 variants. The wide one works on int frames and int masks and does not saturate results. The
+ * narrow one works on unsigned char frames and short masks with saturating arithmetic, exactly like the kernels of
+ * OpenCLKernels.
+ *
+ * On x86 the hottest loops (applying masks, updating similarity levels and flicker counters) are also compiled for
+ * SSE4.2, AVX2 and AVX-512 (see CPUKernelVariant). The best variant supported by the processor is selected when it is
+ * used for the first time, so one binary uses wide vectors where they are available. Variants can be disabled with the
+ * OPENCV_CPU_DISABLE environment variable of OpenCV (for example OPENCV_CPU_DISABLE=AVX512F,AVX2).
+ */
+class CPUKernels {
+public:
+    /**
+     * @brief Subtracts mask from the frame. Wide variant stores result without saturation, narrow variant saturates it
+     * to 0-255.
+     * @param src Source frame with unsigned char pixels. <b>src[i]</b> must be valid for every <b>i</b> in range.
+     * @param mask Mask subtracted from the frame or a plane with nullptr data if frame should be only converted.
+     * @param begin First processed linear index.
+     * @param end Linear index after the last processed one.
+     * @param dst Returned frame with removed flickering.
+     */
+    static void applyMask(const unsigned char *src, PixelPlane<const int> mask, unsigned int begin, unsigned int end,
+                          PixelPlane<int> dst);
+    static void applyMask(const unsigned char *src, PixelPlane<const short> mask, unsigned int begin,
+                          unsigned int end, PixelPlane<unsigned char> dst);
+
+    /**
+     * @brief Copies pixels of the frame to the continuous buffer.
+     * @param src Copied frame.
+     * @param begin First copied linear index.
+     * @param end Linear index after the last copied one.
+     * @param dst Returned continuous copy of the frame.
+     */
+    static void copyFrame(PixelPlane<const int> src, unsigned int begin, unsigned int end, int *dst);
+    static void copyFrame(PixelPlane<const unsigned char> src, unsigned int begin, unsigned int end,
+                          unsigned char *dst);
+
+    /**
+     * @brief Compares 2 frames pixel by pixel and marks pixels which values differ by at most <b>threshold</b> as
+     * similar. Flags of similarity are stored as packed bits in <b>new_levels</b>. The running sum of similarity flags
+     * <b>dst_levels</b> is updated by adding new flags and subtracting flags from <b>old_levels</b> which are removed
+     * from the sum.
+     * @param src_1 First frame.
+     * @param src_2 Second frame.
+     * @param begin First processed linear index.
+     * @param end Linear index after the last processed one.
+     * @param threshold Maximum absolute difference of values of 2 pixels treated as similar.
+     * @param old_levels Packed similarity flags removed from the running sum.
+     * @param new_levels Returned packed similarity flags of the compared frames.
+     * @param dst_levels Running sum of similarity flags or nullptr if only new flags should be calculated.
+     */
+    static void updateSimilarityLevels(PixelPlane<const int> src_1, PixelPlane<const int> src_2, unsigned int begin,
+                                       unsigned int end, int threshold, const uint64_t *old_levels,
+                                       uint64_t *new_levels, unsigned char *dst_levels);
+    static void updateSimilarityLevels(PixelPlane<const unsigned char> src_1, PixelPlane<const unsigned char> src_2,
+                                       unsigned int begin, unsigned int end, int threshold,
+                                       const uint64_t *old_levels, uint64_t *new_levels, unsigned char *dst_levels);
+
+    /**
+     * @brief Finds candidates for flickering: pixels which were similar in corresponding frames of enough blocks.
+     * @param corresponding_sum Running sum of similarity flags of corresponding frames from different blocks.
+     * @param min_similar_blocks Minimum value of <b>corresponding_sum</b> of the candidate.
+     * @param begin First processed linear index.
+     * @param end Linear index after the last processed one.
+     * @param candidates Returned words of flags of candidates. Flag of the pixel <b>i</b> is stored as bit
+     * <b>(i - begin) % 64</b> of word <b>(i - begin) / 64</b>.
+     */
+    static void findCandidates(const unsigned char *corresponding_sum, unsigned int min_similar_blocks,
+                               unsigned int begin, unsigned int end, uint64_t *candidates);
+
+    /**
+     * @brief Finds pixels which were similar in all pairs of adjacent frames of the last block.
+     * @param adjacent_sum Running sum of similarity flags of adjacent frames of the last block.
+     * @param number_of_pairs Number of pairs of adjacent frames in the block (block size - 1).
+     * @param begin First processed linear index.
+     * @param end Linear index after the last processed one.
+     * @param static_pixels Returned words of flags of static pixels in the format of <b>findCandidates()</b>.
+     */
+    static void findStaticPixels(const unsigned char *adjacent_sum, unsigned int number_of_pairs, unsigned int begin,
+                                 unsigned int end, uint64_t *static_pixels);
+
+    /**
+     * @brief Runs the end of block step of the algorithm. For flickering pixels (candidates for flickering which
+     * changed inside the last block) flicker counter is incremented, for other pixels it is zeroed. When the counter
+     * exceeds <b>max_duration</b> masks of the pixel are refined with the differences between frames of the last
+     * block, the counter is zeroed and the new mask is applied to the last frame. Block sizes from 2 to 5 (cameras
+     * with 100-250 fps) use versions specialized at compile time with fully unrolled loops over frames and masks.
+     * @param frames Frames of the last block, from the oldest to the newest. There are <b>block_size</b> of them.
+     * @param block_size Number of frames in the block.
+     * @param masks Masks refined by this algorithm. There are <b>block_size - 1</b> of them.
+     * @param flickering Words of flags of flickering pixels in the format returned by <b>findCandidates()</b>.
+     * @param max_duration Maximum number of consecutive blocks for which the pixel can flicker before masks are refined.
+     * @param begin First processed linear index.
+     * @param end Linear index after the last processed one.
+     * @param flicker_counter Counters of consecutive flickering blocks.
+     * @param last_frame The newest frame of the block (the same as the last element of <b>frames</b>) to which refined
+     * masks are applied, or a plane with nullptr data if refined masks should be used only for the next frames (as on
+     * GPU).
+     * @param refined Returned words of flags of pixels which masks were refined in the format of
+     * <b>findCandidates()</b>, or nullptr if they are not needed.
+     */
+    static void updateFlickerCounter(const PixelPlane<const int> *frames, unsigned int block_size,
+                                     const PixelPlane<int> *masks, const uint64_t *flickering, int max_duration,
+                                     unsigned int begin, unsigned int end, unsigned char *flicker_counter,
+                                     PixelPlane<int> last_frame, uint64_t *refined);
+    static void updateFlickerCounter(const PixelPlane<const unsigned char> *frames, unsigned int block_size,
+                                     const PixelPlane<short> *masks, const uint64_t *flickering, int max_duration,
+                                     unsigned int begin, unsigned int end, unsigned char *flicker_counter,
+                                     PixelPlane<unsigned char> last_frame, uint64_t *refined);
+
+    /**
+     * @brief Name of the instruction set used by kernels on this processor: "AVX-512", "AVX2", "SSE4.2" or "baseline"
+     * if only universal intrinsics are used.
+     */
+    static const char *getInstructionSet();
+};
+
+
+#endif //CPU_KERNELS_HPP
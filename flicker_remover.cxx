@@ -4,6 +4,7 @@
 
 #include "flicker_remover.hpp"
 #include <opencv2/opencv.hpp>
+#include "state_file.hpp"
 
 using namespace cv;
 
@@ -12,17 +13,76 @@ using std::to_string;
 
 const double FlickerRemover::FIRST_TIMESTAMP = -1;
 
+namespace {
+/**
+ * @brief Checks if the buffer of the frame is referenced by other UMat or Mat headers, for example by frames still held
+ * by the caller of <b>FlickerRemover::removeFlickering()</b>.
+ */
+bool isShared(const UMat &frame)
+{
+    return frame.u != nullptr && (frame.u->urefcount > 1 || frame.u->refcount > 0);
+}
+
+/**
+ * @brief Kind and version of the format of saved states.
+ */
+const char STATE_KIND[] = "FlickerRemover";
+const uint32_t STATE_VERSION = 1;
+
+/**
+ * @brief Writes all elements of the matrix stored on the device.
+ */
+void writeMatrix(StateWriter &writer, const UMat &matrix)
+{
+    writer.writeMatrix(matrix.getMat(ACCESS_READ));
+}
+
+/**
+ * @brief Reads all elements of the matrix stored on the device. The matrix is mapped only until the end of reading.
+ */
+void readMatrix(StateReader &reader, UMat &matrix)
+{
+    Mat data = matrix.getMat(ACCESS_WRITE);
+    reader.readMatrix(data);
+}
+
+/**
+ * @brief Returns size of frames from which masks are learnt.
+ * @param size Height or width of processed frames.
+ * @param learning_scale Factor by which frames are downsampled for learning.
+ */
+int learningSize(int size, unsigned int learning_scale)
+{
+    if(learning_scale != 1 && learning_scale != 2 && learning_scale != 4) {
+        throw std::runtime_error("Learning scale must be equal to 1, 2 or 4.");
+    }
+    if(size % (int) learning_scale != 0) {
+        throw std::runtime_error("Size of frames must be a multiple of the learning scale.");
+    }
+    return size / (int) learning_scale;
+}
+}
+
 
 FlickerRemover::FlickerRemover(OpenCLKernels &opencl_kernels, unsigned int camera_fps, int flickering_threshold,
-                               int max_allowed_flicker_duration, int frame_rows, int frame_cols)
+                               int max_allowed_flicker_duration, int frame_rows, int frame_cols,
+                               unsigned int learning_scale)
         : opencl_kernels(opencl_kernels), frame_rows(frame_rows), frame_cols(frame_cols),
+          learning_scale(learning_scale), learning_rows(learningSize(frame_rows, learning_scale)),
+          learning_cols(learningSize(frame_cols, learning_scale)),
           expected_timestamp(FIRST_TIMESTAMP), timestamps_delta(1000.0 / camera_fps),
           accepted_timestamp_difference(timestamps_delta / 3),
-          flicker_counter(frame_rows, frame_cols, CV_8U, Scalar(0)),
+          flicker_counter(learningSize(frame_rows, learning_scale), learningSize(frame_cols, learning_scale), CV_8U,
+                          Scalar(0)),
           flickering_threshold(flickering_threshold), max_allowed_flicker_duration(max_allowed_flicker_duration),
-          corresponding_frames_similarity_sum(frame_rows, frame_cols, CV_8U, Scalar(0)), frames_block(0),
+          corresponding_frames_similarity_sum(learningSize(frame_rows, learning_scale),
+                                              learningSize(frame_cols, learning_scale), CV_8U, Scalar(0)),
+          frames_block(0),
           corresponding_frames_similarity_levels(0),
-          adjacent_frames_similarity_sum(frame_rows, frame_cols, CV_8U, Scalar(0)), adjacent_frames_similarity_levels(0)
+          adjacent_frames_similarity_sum(learningSize(frame_rows, learning_scale),
+                                         learningSize(frame_cols, learning_scale), CV_8U, Scalar(0)),
+          adjacent_frames_similarity_levels(0),
+          learning_scheduler(0)
 {
     //calculate number of masks
     const unsigned int current_frequency = 50;
@@ -43,19 +103,27 @@ FlickerRemover::FlickerRemover(OpenCLKernels &opencl_kernels, unsigned int camer
     number_of_masks = count - 1;
     block_size = count;
     frames_block.setMaxSize(block_size);
+    learning_scheduler.setBlockSize(block_size);
     masks.reserve(number_of_masks);
     for(unsigned int j = 0; j < number_of_masks; j++) {
-        masks.emplace_back(frame_rows, frame_cols, CV_16S, Scalar(0));
+        masks.emplace_back(learning_rows, learning_cols, CV_16S, Scalar(0));
     }
+    refined_tiles = UMat((learning_rows + OpenCLKernels::MASK_TILE_SIZE - 1) / OpenCLKernels::MASK_TILE_SIZE,
+                         (learning_cols + OpenCLKernels::MASK_TILE_SIZE - 1) / OpenCLKernels::MASK_TILE_SIZE, CV_8U,
+                         Scalar(0));
     actual_mask = number_of_masks;
+    //one more buffer than frames in the block, so the new frame can be written while the oldest one is still needed
+    frame_pool.reserve(block_size + 1);
+    for(unsigned int j = 0; j < block_size + 1; j++) {
+        frame_pool.emplace_back(learning_rows, learning_cols, CV_8UC1);
+    }
+    spare_frame = takeFromFramePool();
     corresponding_frames_similarity_levels.setMaxSize(block_size);
     adjacent_frames_similarity_levels.setMaxSize(block_size - 1);
-    for(unsigned int j = 0; j < block_size; j++) {
-        corresponding_frames_similarity_levels.push(new UMat(frame_rows, frame_cols, CV_8UC1, Scalar(0)));
-    }
-    for(unsigned int j = 0; j < block_size - 1; j++) {
-        adjacent_frames_similarity_levels.push(new UMat(frame_rows, frame_cols, CV_8UC1, Scalar(0)));
-    }
+    allocateSimilarityLevels();
+    zero_levels = UMat(learning_rows, learning_cols, CV_8UC1, Scalar(0));
+    stale_corresponding_levels = 0;
+    stale_adjacent_levels = 0;
 }
 
 FlickerRemover::~FlickerRemover()
@@ -63,20 +131,21 @@ FlickerRemover::~FlickerRemover()
     clear();
 }
 
-UMat *FlickerRemover::removeFlickering(const UMat &frame, double timestamp, string &error)
+bool FlickerRemover::removeFlickering(const UMat &frame, double timestamp, UMat &frame_without_flickering,
+                                      string &error)
 {
     if(frame.rows != frame_rows || frame.cols != frame_cols) {
         error = "Flickering cannot be removed. Size of the frame: " + to_string(frame.cols) + "x" +
                 to_string(frame.rows) + " is different than expected: " + to_string(frame_cols) + "x" +
                 to_string(frame_rows) + ".";
-        return nullptr;
+        return false;
     }
     if(!timestampIsCloseToExpectedTimestamp(timestamp)) {
         //very unlikely. Should not happen...
         if(timestamp < expected_timestamp) {
             error = "Received unexpected timestamp: " + to_string(timestamp) + " Expected value close to: " +
                     to_string(expected_timestamp);
-            return nullptr;
+            return false;
         }
         //calculate number of frames that were dropped
         auto number_of_dropped = (unsigned int) ((timestamp - expected_timestamp + accepted_timestamp_difference) /
@@ -86,46 +155,106 @@ UMat *FlickerRemover::removeFlickering(const UMat &frame, double timestamp, stri
     }
     calculateNextExpectedTimestamp(timestamp);
 
-    auto frame_copy = new UMat(frame_rows, frame_cols, CV_8UC1);
+    //position of the frame in the block, the first frame of the block has no mask applied
+    const unsigned int position = actual_mask == number_of_masks ? 0 : actual_mask + 1;
+    if(load_shedder.nextFrame(position)) {
+        clearHistory();
+    }
+    if(load_shedder.getAction() == OverloadAction::DROP_BLOCK) {
+        //the mask phase advances as if the frame was processed, so the next block starts with its first frame
+        actual_mask = actual_mask == number_of_masks ? 0 : actual_mask + 1;
+        frame_without_flickering.release();
+        return true;
+    }
+    if(learning_scheduler.nextFrame(position, [&frame]() {
+        return mean(frame)[0];
+    })) {
+        clearHistory();
+    }
+
+    const UMat *learning_input = &frame;
+    if(learning_scale > 1) {
+        if(!isLearning()) {
+            //history is not updated, so the frame is not downsampled at all
+            actual_mask = actual_mask == number_of_masks ? 0 : actual_mask + 1;
+            applyUpsampledMask(frame, position, frame_without_flickering);
+            return true;
+        }
+        //box filter, so every pixel of the learning frame is the mean of one block of pixels of the frame
+        resize(frame, learning_frame, Size(learning_cols, learning_rows), 0, 0, INTER_AREA);
+        learning_input = &learning_frame;
+    }
+
+    if(isShared(spare_frame)) {
+        //the caller still holds this frame, so leave it to the caller and use a new buffer in its place
+        spare_frame = UMat(learning_rows, learning_cols, CV_8UC1);
+    }
 
     if(actual_mask == number_of_masks) {
         actual_mask = 0;
-        frame.convertTo(*frame_copy, CV_8UC1);
+        learning_input->convertTo(spare_frame, CV_8UC1);
+    } else if(learning_input->type() == CV_8UC1) {
+        //only tiles with refined masks are subtracted, other tiles are copied
+        auto ret = opencl_kernels.runKernelApplyMask(*learning_input, masks[actual_mask], refined_tiles, spare_frame,
+                                                     error);
+        actual_mask++;
+        if(!ret) {
+            return false;
+        }
     } else {
-        subtract(frame, masks[actual_mask], *frame_copy, noArray(), CV_8UC1);
+        subtract(*learning_input, masks[actual_mask], spare_frame, noArray(), CV_8UC1);
         actual_mask++;
     }
 
-    auto last_frame = frames_block.last();
-    if(last_frame != nullptr) {
-        auto new_adjacent_similarity = new UMat(frame_rows, frame_cols, CV_8UC1, Scalar(0));
+    if(!isLearning()) {
+        //history is not updated, so the spare buffer only holds the frame with the mask applied
+        frame_without_flickering = spare_frame;
+        return true;
+    }
+
+    if(!frames_block.isEmpty()) {
+        auto new_adjacent_similarity = spare_adjacent_levels;
         auto old_adjacent_similarity = adjacent_frames_similarity_levels.push(new_adjacent_similarity);
+        const UMat *removed_adjacent_similarity = old_adjacent_similarity;
+        if(stale_adjacent_levels > 0) {
+            //levels stored before the history was cleared are not in sums anymore
+            stale_adjacent_levels--;
+            removed_adjacent_similarity = &zero_levels;
+        }
 
-        auto ret = opencl_kernels.runKernelUpdateSimilarityLevels(*last_frame, *frame_copy, *old_adjacent_similarity,
+        auto ret = opencl_kernels.runKernelUpdateSimilarityLevels(frames_block.last(), spare_frame,
+                                                                  *removed_adjacent_similarity,
                                                                   flickering_threshold, *new_adjacent_similarity,
                                                                   adjacent_frames_similarity_sum, error);
-        delete old_adjacent_similarity;
+        spare_adjacent_levels = old_adjacent_similarity;
         if(!ret) {
-            delete frame_copy;
-            return nullptr;
+            return false;
         }
     }
 
-    //push returns pointer to the allocated earlier matrix, but do not delete, since we already returned this pointer
-    //outside of this method, and it is the responsibility of the caller to delete this pointer.
-    auto prev_frame = frames_block.push(frame_copy);
-
-    if(prev_frame != nullptr) {
-        auto new_similarity_levels = new UMat(frame_rows, frame_cols, CV_8UC1, Scalar(0));
+    //push returns the oldest frame, which is recycled as the spare buffer after this frame is processed
+    UMat prev_frame = frames_block.push(std::move(spare_frame));
+    const UMat &frame_copy = frames_block.last();
+    if(!prev_frame.empty()) {
+        auto new_similarity_levels = spare_corresponding_levels;
         auto old_similarity_levels = corresponding_frames_similarity_levels.push(new_similarity_levels);
+        const UMat *removed_similarity_levels = old_similarity_levels;
+        if(stale_corresponding_levels > 0) {
+            stale_corresponding_levels--;
+            removed_similarity_levels = &zero_levels;
+        }
 
-        auto ret = opencl_kernels.runKernelUpdateSimilarityLevels(*prev_frame, *frame_copy, *old_similarity_levels,
+        auto ret = opencl_kernels.runKernelUpdateSimilarityLevels(prev_frame, frame_copy, *removed_similarity_levels,
                                                                   flickering_threshold, *new_similarity_levels,
                                                                   corresponding_frames_similarity_sum, error);
-        delete old_similarity_levels;
+        spare_corresponding_levels = old_similarity_levels;
+        spare_frame = std::move(prev_frame);
         if(!ret) {
-            return nullptr;
+            return false;
         }
+    } else {
+        //frames block is not full yet, so take the next unused buffer
+        spare_frame = takeFromFramePool();
     }
 
     if(actual_mask == number_of_masks && frames_block.isFull()) {
@@ -133,21 +262,43 @@ UMat *FlickerRemover::removeFlickering(const UMat &frame, double timestamp, stri
                                                                 corresponding_frames_similarity_sum,
                                                                 0.7f * (float) block_size, flicker_counter, error);
         if(!ret) {
-            return nullptr;
+            return false;
         }
         for(int i = 0; i < (int) number_of_masks; i++) {
-            ret = opencl_kernels.runKernelUpdateMasks(*(frames_block[0]), *(frames_block[i + 1]), flicker_counter,
-                                                      max_allowed_flicker_duration, masks[i], error);
+            ret = opencl_kernels.runKernelUpdateMasks(frames_block[0], frames_block[i + 1], flicker_counter,
+                                                      max_allowed_flicker_duration, masks[i], refined_tiles,
+                                                      error);
             if(!ret) {
-                return nullptr;
+                return false;
             }
         }
         ret = opencl_kernels.runKernelZeroFlickerCounter(max_allowed_flicker_duration, flicker_counter, error);
         if(!ret) {
-            return nullptr;
+            return false;
         }
     }
-    return frame_copy;
+    if(learning_scale > 1) {
+        //the mask is applied after learning, so masks refined at the end of the block already apply to this frame
+        applyUpsampledMask(frame, position, frame_without_flickering);
+    } else {
+        frame_without_flickering = frame_copy;
+    }
+    return true;
+}
+
+void FlickerRemover::applyUpsampledMask(const UMat &frame, unsigned int position, UMat &frame_without_flickering)
+{
+    if(isShared(output_frame)) {
+        output_frame = UMat(frame_rows, frame_cols, CV_8UC1);
+    }
+    if(position == 0) {
+        frame.convertTo(output_frame, CV_8UC1);
+    } else {
+        //nearest neighbour interpolation applies every value of the mask to the whole block of pixels
+        resize(masks[position - 1], upsampled_mask, Size(frame_cols, frame_rows), 0, 0, INTER_NEAREST);
+        subtract(frame, upsampled_mask, output_frame, noArray(), CV_8UC1);
+    }
+    frame_without_flickering = output_frame;
 }
 
 bool FlickerRemover::timestampIsCloseToExpectedTimestamp(double timestamp) const
@@ -168,28 +319,209 @@ unsigned int FlickerRemover::getNumberOfStoredFrames() const
 
 void FlickerRemover::reset()
 {
-    clear();
-    corresponding_frames_similarity_levels.clear();
-    adjacent_frames_similarity_levels.clear();
+    clearHistory();
+    //buffers are zeroed in place by the device, so nothing is allocated and the host does not wait
+    for(auto &mask: masks) {
+        mask.setTo(Scalar(0));
+    }
+    refined_tiles.setTo(Scalar(0));
+    actual_mask = number_of_masks;
+    learning_scheduler.reset();
+    load_shedder.reset();
+}
+
+bool FlickerRemover::setLearningSchedule(const LearningSchedule &schedule, string &error)
+{
+    const unsigned int warm_up_blocks = getWarmUpDuration() / block_size;
+    if(schedule.learning_blocks != 0 && schedule.learning_blocks < warm_up_blocks) {
+        error = "Learning schedule cannot be set. Learning phase must last at least " + to_string(warm_up_blocks) +
+                " blocks to refine masks.";
+        return false;
+    }
+    learning_scheduler.setSchedule(schedule);
+    return true;
+}
+
+const LearningSchedule &FlickerRemover::getLearningSchedule() const
+{
+    return learning_scheduler.getSchedule();
+}
+
+bool FlickerRemover::isLearning() const
+{
+    return learning_scheduler.isLearning() && load_shedder.getAction() == OverloadAction::NONE;
+}
+
+bool FlickerRemover::setOverloadPolicy(const OverloadPolicy &policy, string &error)
+{
+    return load_shedder.setPolicy(policy, error);
+}
+
+const OverloadPolicy &FlickerRemover::getOverloadPolicy() const
+{
+    return load_shedder.getPolicy();
+}
+
+const OverloadCounters &FlickerRemover::getOverloadCounters() const
+{
+    return load_shedder.getCounters();
+}
+
+void FlickerRemover::setInputLag(double lag)
+{
+    load_shedder.setLag(lag);
+}
+
+void FlickerRemover::clearHistory()
+{
+    returnFramesToFramePool();
+    //both buffers of similarity levels stay full, all their levels become stale and only sums are zeroed
+    stale_corresponding_levels = corresponding_frames_similarity_levels.size();
+    stale_adjacent_levels = adjacent_frames_similarity_levels.size();
     flicker_counter.setTo(Scalar(0));
     corresponding_frames_similarity_sum.setTo(Scalar(0));
     adjacent_frames_similarity_sum.setTo(Scalar(0));
-    masks.clear();
-    masks.reserve(number_of_masks);
-    for(unsigned int j = 0; j < number_of_masks; j++) {
-        masks.emplace_back(frame_rows, frame_cols, CV_16S, Scalar(0));
+}
+
+UMat FlickerRemover::takeFromFramePool()
+{
+    UMat frame = std::move(frame_pool.back());
+    frame_pool.pop_back();
+    return frame;
+}
+
+void FlickerRemover::returnFramesToFramePool()
+{
+    //the pool has room for all buffers, so moving frames does not allocate memory
+    while(!frames_block.isEmpty()) {
+        frame_pool.push_back(frames_block.pop());
     }
-    actual_mask = number_of_masks;
+}
+
+bool FlickerRemover::saveState(const string &path, string &error) const
+{
+    StateWriter writer(path, STATE_KIND, STATE_VERSION);
+    writer.write((int32_t) frame_rows);
+    writer.write((int32_t) frame_cols);
+    writer.write((uint32_t) learning_scale);
+    writer.write((uint32_t) block_size);
+    writer.write(timestamps_delta);
+
+    writer.write((uint32_t) actual_mask);
+    writeMatrix(writer, refined_tiles);
+    for(const auto &mask: masks) {
+        writeMatrix(writer, mask);
+    }
+    writeMatrix(writer, flicker_counter);
+    writer.write((uint32_t) frames_block.size());
+    for(unsigned int j = 0; j < frames_block.size(); j++) {
+        writeMatrix(writer, frames_block[(int) j]);
+    }
+    //sums are sums of similarity levels, so they are calculated again when the state is restored
+    for(unsigned int j = 0; j < corresponding_frames_similarity_levels.size(); j++) {
+        writeMatrix(writer, j < stale_corresponding_levels ? zero_levels :
+                            *corresponding_frames_similarity_levels[(int) j]);
+    }
+    for(unsigned int j = 0; j < adjacent_frames_similarity_levels.size(); j++) {
+        writeMatrix(writer, j < stale_adjacent_levels ? zero_levels : *adjacent_frames_similarity_levels[(int) j]);
+    }
+    return writer.commit(error);
+}
+
+bool FlickerRemover::loadState(const string &path, string &error)
+{
+    StateReader reader(path, STATE_KIND, STATE_VERSION);
+    const auto rows = reader.read<int32_t>();
+    const auto cols = reader.read<int32_t>();
+    const auto scale = reader.read<uint32_t>();
+    const auto saved_block_size = reader.read<uint32_t>();
+    const auto saved_timestamps_delta = reader.read<double>();
+    if(!reader.isValid()) {
+        return reader.finish(error);
+    }
+    //parameters are checked first, so the state of this flicker remover is not changed if they do not match
+    if(rows != frame_rows || cols != frame_cols) {
+        error = "State cannot be restored. It was saved for frames of size: " + to_string(cols) + "x" +
+                to_string(rows) + " different than expected: " + to_string(frame_cols) + "x" + to_string(frame_rows) +
+                ".";
+        return false;
+    }
+    if(saved_block_size != block_size || std::abs(saved_timestamps_delta - timestamps_delta) > 1e-9) {
+        error = "State cannot be restored. It was saved for camera with fps: " +
+                to_string(1000.0 / saved_timestamps_delta) + " different than expected: " +
+                to_string(1000.0 / timestamps_delta) + ".";
+        return false;
+    }
+    if(scale != learning_scale) {
+        error = "State cannot be restored. It was saved with different learning scale.";
+        return false;
+    }
+
+    const auto saved_actual_mask = reader.read<uint32_t>();
+    readMatrix(reader, refined_tiles);
+    for(auto &mask: masks) {
+        readMatrix(reader, mask);
+    }
+    readMatrix(reader, flicker_counter);
+    const auto number_of_frames = reader.read<uint32_t>();
+    if(saved_actual_mask > number_of_masks || number_of_frames > block_size) {
+        reset();
+        error = "State cannot be restored. File is corrupted.";
+        return false;
+    }
+    returnFramesToFramePool();
+    for(unsigned int j = 0; j < number_of_frames; j++) {
+        UMat frame = takeFromFramePool();
+        if(isShared(frame)) {
+            //the caller still holds this frame, so it is not overwritten
+            frame = UMat(learning_rows, learning_cols, CV_8UC1);
+        }
+        readMatrix(reader, frame);
+        frames_block.push(std::move(frame));
+    }
+    corresponding_frames_similarity_sum.setTo(Scalar(0));
+    adjacent_frames_similarity_sum.setTo(Scalar(0));
+    for(unsigned int j = 0; j < corresponding_frames_similarity_levels.size(); j++) {
+        readMatrix(reader, *corresponding_frames_similarity_levels[(int) j]);
+        add(corresponding_frames_similarity_sum, *corresponding_frames_similarity_levels[(int) j],
+            corresponding_frames_similarity_sum);
+    }
+    for(unsigned int j = 0; j < adjacent_frames_similarity_levels.size(); j++) {
+        readMatrix(reader, *adjacent_frames_similarity_levels[(int) j]);
+        add(adjacent_frames_similarity_sum, *adjacent_frames_similarity_levels[(int) j],
+            adjacent_frames_similarity_sum);
+    }
+    if(!reader.finish(error)) {
+        reset();
+        return false;
+    }
+    stale_corresponding_levels = 0;
+    stale_adjacent_levels = 0;
+    actual_mask = saved_actual_mask;
+    //timestamps of the camera usually start over after a restart, so the first timestamp is accepted
+    expected_timestamp = FIRST_TIMESTAMP;
+    learning_scheduler.reset();
+    load_shedder.reset();
+    return true;
+}
+
+void FlickerRemover::allocateSimilarityLevels()
+{
     for(unsigned int j = 0; j < block_size; j++) {
-        corresponding_frames_similarity_levels.push(new UMat(frame_rows, frame_cols, CV_8UC1, Scalar(0)));
+        corresponding_frames_similarity_levels.push(new UMat(learning_rows, learning_cols, CV_8UC1, Scalar(0)));
     }
     for(unsigned int j = 0; j < block_size - 1; j++) {
-        adjacent_frames_similarity_levels.push(new UMat(frame_rows, frame_cols, CV_8UC1, Scalar(0)));
+        adjacent_frames_similarity_levels.push(new UMat(learning_rows, learning_cols, CV_8UC1, Scalar(0)));
     }
-    frames_block.clear();
+    spare_corresponding_levels = new UMat(learning_rows, learning_cols, CV_8UC1, Scalar(0));
+    spare_adjacent_levels = new UMat(learning_rows, learning_cols, CV_8UC1, Scalar(0));
 }
 
 void FlickerRemover::clear() {
+    delete spare_corresponding_levels;
+    spare_corresponding_levels = nullptr;
+    delete spare_adjacent_levels;
+    spare_adjacent_levels = nullptr;
     auto to_delete_1 = corresponding_frames_similarity_levels.pop();
     while(to_delete_1 != nullptr) {
         delete to_delete_1;
@@ -210,7 +542,14 @@ bool FlickerRemover::getMaskOfStaticPixelsOfLastPairOfFrames(Mat &mask, string &
                 "Flicker remover processed less than 2 frames and cannot generate a requested mask.";
         return false;
     } else {
-        adjacent_frames_similarity_levels.last()->copyTo(mask);
+        //levels stored before the history was cleared are treated as zero
+        const bool stale = stale_adjacent_levels == adjacent_frames_similarity_levels.size();
+        (stale ? zero_levels : *adjacent_frames_similarity_levels.last()).copyTo(mask);
+        if(learning_scale > 1) {
+            //every flag describes one block of pixels of the frame
+            Mat learning_mask = mask;
+            resize(learning_mask, mask, Size(frame_cols, frame_rows), 0, 0, INTER_NEAREST);
+        }
 //        int x = 0;
 //        for(unsigned int row = 0; row < mask.rows; ++row) {
 //            for(unsigned int col = 0; col < mask.cols; ++col) {
@@ -219,8 +558,8 @@ bool FlickerRemover::getMaskOfStaticPixelsOfLastPairOfFrames(Mat &mask, string &
 //                }
 //            }
 //        }
-//        auto source = frames_block.last()->getMat(ACCESS_READ);
-//        auto source_prev = frames_block[-2]->getMat(ACCESS_READ);
+//        auto source = frames_block.last().getMat(ACCESS_READ);
+//        auto source_prev = frames_block[-2].getMat(ACCESS_READ);
 //
 //        int y = 0;
 //        for(unsigned int row = 0; row < mask.rows; ++row) {
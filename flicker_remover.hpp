@@ -10,6 +10,8 @@
 #include <string>
 #include "circular_buffer.hpp"
 #include "open_cl_kernels.hpp"
+#include "learning_scheduler.hpp"
+#include "load_shedder.hpp"
 
 using cv::Mat;
 using cv::UMat;
@@ -79,11 +81,32 @@ protected:
     vector<UMat> masks;
 
     /**
-     * @brief Circular buffer of pointers to copies of historical frames. Number of frames is double the number of
+     * @brief Flags of tiles of <b>OpenCLKernels::MASK_TILE_SIZE</b> x <b>OpenCLKernels::MASK_TILE_SIZE</b> pixels in
+     * which masks of at least one pixel were refined since the last reset. Masks of other tiles are zero, so there
+     * frames are only copied. Refinement changes all masks of the pixel, so the flags are shared by all masks.
+     */
+    UMat refined_tiles;
+
+    /**
+     * @brief Circular buffer of copies of historical frames. Number of frames is double the number of
      * frames per block. Number of frames per block is equal to number of masks plus 1.
-     * These frames are used to detect flickering patterns for every pixel.
+     * These frames are used to detect flickering patterns for every pixel. Frames are stored by value, every buffer
+     * of a frame is referenced by exactly one header inside this class.
+     */
+    CircularBuffer<UMat> frames_block;
+
+    /**
+     * @brief Preallocated buffers of historical frames which are not stored in <b>frames_block</b> nor used as
+     * <b>spare_frame</b>. Buffers are recycled, so in the steady state no memory is allocated for frames.
      */
-    CircularBuffer<UMat *> frames_block;
+    vector<UMat> frame_pool;
+
+    /**
+     * @brief Buffer which is not stored in <b>frames_block</b> and which will be used for the copy of the next
+     * processed frame. With the frames of the block it makes one buffer more than frames in the block, so the new
+     * frame can be written while the oldest one is still needed.
+     */
+    UMat spare_frame;
 
     /**
      * @brief Circular buffer of pointers to special arrays with infos about similarities of corresponding frames from
@@ -101,6 +124,27 @@ protected:
      */
     CircularBuffer<UMat *> adjacent_frames_similarity_levels;
 
+    /**
+     * @brief Spare similarity levels used for the next frame. Levels removed from
+     * <b>corresponding_frames_similarity_levels</b> and <b>adjacent_frames_similarity_levels</b> are recycled as the
+     * next spare ones, so in the steady state no memory is allocated for similarity levels.
+     */
+    UMat *spare_corresponding_levels;
+    UMat *spare_adjacent_levels;
+
+    /**
+     * @brief Similarity levels with all flags cleared, used in place of stale levels removed from similarity buffers.
+     */
+    UMat zero_levels;
+
+    /**
+     * @brief Numbers of the oldest levels in <b>corresponding_frames_similarity_levels</b> and
+     * <b>adjacent_frames_similarity_levels</b> which were stored before the history was cleared. They are not zeroed,
+     * they are treated as zero when they are removed from buffers and then overwritten as spare levels.
+     */
+    unsigned int stale_corresponding_levels;
+    unsigned int stale_adjacent_levels;
+
     /**
      * @brief Special array with infos about levels of similarities of different blocks. The array is the sum of values
      * from all <b>corresponding_frames_similarity_levels</b>. It is used to speed up processing.
@@ -143,6 +187,30 @@ protected:
      */
     const int frame_cols;
 
+    /**
+     * @brief Factor by which frames are downsampled before masks are learnt. Flickering of lamps is spatially smooth,
+     * so with <b>learning_scale</b> bigger than 1 historical frames, similarity levels, flicker counters and masks
+     * describe blocks of <b>learning_scale</b> x <b>learning_scale</b> pixels, and every value of the mask is applied
+     * to the whole block of pixels of the frame.
+     */
+    const unsigned int learning_scale;
+
+    /**
+     * @brief Height and width of frames from which masks are learnt. They are equal to <b>frame_rows</b> and
+     * <b>frame_cols</b> divided by <b>learning_scale</b>.
+     */
+    const int learning_rows;
+    const int learning_cols;
+
+    /**
+     * @brief Buffers used when <b>learning_scale</b> is bigger than 1: the downsampled copy of the processed frame, the
+     * applied mask upsampled to the size of the frame and the returned frame, which is recycled unless the caller still
+     * holds it.
+     */
+    UMat learning_frame;
+    UMat upsampled_mask;
+    UMat output_frame;
+
     /**
      * @brief Expected value of the timestamp of the next frame to be processed. It is calculated based on camera's fps
      * and last timestamp. It may be a value in milliseconds or -1 (FIRST_TIMESTAMP) to indicate that we accept any
@@ -150,6 +218,17 @@ protected:
      */
     double expected_timestamp;
 
+    /**
+     * @brief Decides for every frame if masks are learnt or only applied.
+     */
+    LearningScheduler learning_scheduler;
+
+    /**
+     * @brief Decides for every frame if it is processed normally, only has the mask applied or is dropped when frames
+     * arrive faster than they are processed.
+     */
+    LoadShedder load_shedder;
+
     /**
      * @brief Checks if passed in parameter timestamp is similar to the expected timestamp of the next frame.
      * @param timestamp Timestamp to be checked.
@@ -164,11 +243,41 @@ protected:
     void calculateNextExpectedTimestamp(double timestamp);
 
     /**
-     * @brief Removes allocated earlier data in corresponding_frames_similarity_levels and
-     * adjacent_frames_similarity_levels.
+     * @brief Applies the mask learnt at reduced resolution to the full resolution frame.
+     * @param frame Source frame.
+     * @param position Position of the frame in the block. No mask is applied to the first frame of the block.
+     * @param frame_without_flickering Returned frame with the mask applied.
+     */
+    void applyUpsampledMask(const UMat &frame, unsigned int position, UMat &frame_without_flickering);
+
+    /**
+     * @brief Allocates zeroed similarity levels for corresponding_frames_similarity_levels,
+     * adjacent_frames_similarity_levels and spare levels.
+     */
+    void allocateSimilarityLevels();
+
+    /**
+     * @brief Removes allocated earlier data in corresponding_frames_similarity_levels,
+     * adjacent_frames_similarity_levels and spare levels.
      */
     void clear();
 
+    /**
+     * @brief Forgets historical frames, similarity levels and flicker counters, but keeps masks, so learning can start
+     * over while masks are still applied.
+     */
+    void clearHistory();
+
+    /**
+     * @brief Takes an unused buffer of a historical frame from <b>frame_pool</b>. The pool must not be empty.
+     */
+    UMat takeFromFramePool();
+
+    /**
+     * @brief Moves all frames from <b>frames_block</b> back to <b>frame_pool</b>, so the block is empty.
+     */
+    void returnFramesToFramePool();
+
 public:
     /**
      * @brief Constructor. Based on fps of the camera calculates number of masks.
@@ -182,9 +291,12 @@ public:
      * before being removed.
      * @param frame_rows Height of the frames that can be processed by this flickering remover.
      * @param frame_cols Width of the frames that can be processed by this flickering remover.
+     * @param learning_scale Factor equal to 1, 2 or 4 by which frames are downsampled with a box filter before masks are
+     * learnt. Frame sizes must be its multiples. Learning cost and memory of the state drop by its square, and masks
+     * are applied to blocks of pixels of full resolution frames.
      */
     FlickerRemover(OpenCLKernels &opencl_kernels, unsigned int camera_fps, int flickering_threshold,
-                   int max_allowed_flicker_duration, int frame_rows, int frame_cols);
+                   int max_allowed_flicker_duration, int frame_rows, int frame_cols, unsigned int learning_scale = 1);
 
     /**
      * @brief Default destructor.
@@ -192,18 +304,25 @@ public:
     virtual ~FlickerRemover();
 
     /**
-     * @brief Creates and returns pointer to the new frame which is constructed from passed in parameter frame
-     * by applying one of the masks calculated earlier. It also refines mask used to remove flickering.
-     * @param frame Frame from which copy is made and from this copy flickering is removed. Pointer to the copy is
-     * returned.
+     * @brief Makes a copy of the passed in parameter frame and removes flickering from it by applying one of the masks
+     * calculated earlier. It also refines mask used to remove flickering.
+     *
+     * The copy is stored in one of the buffers of the internal pool. Returned frame shares this buffer (UMat is
+     * reference counted), so it stays valid for as long as the caller keeps it. The buffer is recycled after
+     * <b>getNumberOfStoredFrames()</b> next calls. If the caller still holds the returned frame then, a new buffer is
+     * allocated in its place, so frames held by the caller are never overwritten. Frames should be released earlier
+     * to avoid allocations.
+     * @param frame Frame from which copy is made and from this copy flickering is removed.
      * @param timestamp Timestamp of the frame used to control if we remove flickering from consecutive frames.
      * The algorithm of this class uses set of masks that have to be applied in accurate order. If we dropped one or
      * more frames we have to detect such situations and adapt the order of applying masks. We use timestamps to detect
      * frame drops.
+     * @param frame_without_flickering Returned copy of the frame with removed flickering.
      * @param error Returned description of the problem if an error occurs.
-     * @return Pointer to the newly allocated frame or nullptr in case of an error.
+     * @return True if flickering was removed or the frame was dropped by the overload policy (then the returned frame
+     * is empty), false in case of an error.
      */
-    UMat *removeFlickering(const UMat &frame, double timestamp, string &error);
+    bool removeFlickering(const UMat &frame, double timestamp, UMat &frame_without_flickering, string &error);
 
     /**
      * @brief Getter for calculated number of elements stored in blocks buffer.
@@ -213,10 +332,54 @@ public:
     [[nodiscard]] unsigned int getNumberOfStoredFrames() const;
 
     /**
-     * @brief Resets internal state, so the processing can start over.
+     * @brief Resets internal state, so the processing can start over. Learning of masks is resumed, but the schedule
+     * of learning and the overload policy with its counters are kept. No memory is allocated, similarity levels are
+     * zeroed lazily when they are overwritten and other buffers are zeroed by the device.
      */
     void reset();
 
+    /**
+     * @brief Sets the schedule of learning of masks. While learning is frozen, <b>removeFlickering()</b> only applies
+     * masks to frames, so no other kernels are run. When learning is resumed, history of frames is cleared and it is
+     * gathered again. By default learning is never frozen.
+     * @param schedule New schedule.
+     * @param error Returned description of the problem if an error occurs.
+     * @return True if the schedule was set, false if its learning phases are too short to refine any mask.
+     */
+    bool setLearningSchedule(const LearningSchedule &schedule, string &error);
+
+    [[nodiscard]] const LearningSchedule &getLearningSchedule() const;
+
+    /**
+     * @brief True if masks were learnt with the last processed frame, false if learning was frozen or suspended by the
+     * overload policy.
+     */
+    [[nodiscard]] bool isLearning() const;
+
+    /**
+     * @brief Sets the policy for frames arriving faster than they are processed. Lags are reported with
+     * <b>setInputLag()</b>. Dropped frames advance the mask phase like processed ones, and when learning is resumed
+     * history of frames is cleared, so masks are refined only with consecutive frames. By default the policy is
+     * disabled.
+     * @param policy New policy.
+     * @param error Returned description of the problem if an error occurs.
+     * @return True if the policy was set, false if its thresholds are invalid.
+     */
+    bool setOverloadPolicy(const OverloadPolicy &policy, string &error);
+
+    [[nodiscard]] const OverloadPolicy &getOverloadPolicy() const;
+
+    /**
+     * @brief Returns numbers of times the overload policy fired since construction.
+     */
+    [[nodiscard]] const OverloadCounters &getOverloadCounters() const;
+
+    /**
+     * @brief Reports the lag of the input, used by the overload policy for the next frames.
+     * @param lag Lag in milliseconds, for example the age of the next frame waiting in the input queue.
+     */
+    void setInputLag(double lag);
+
     /**
      * @brief Returns a matrix with pixels set to 1 where there was no movement detected and 0 for pixels that were
      * detected as movement.
@@ -226,6 +389,29 @@ public:
      */
     bool getMaskOfStaticPixelsOfLastPairOfFrames(Mat &mask, string &error) const;
 
+    /**
+     * @brief Saves the learnt state to the binary file: masks, flicker counters, historical frames, similarity levels
+     * and the phase of masks. Sums of similarity levels are not saved, because they are calculated from levels. The
+     * file is replaced only when the whole state is written.
+     * @param path Path of the file.
+     * @param error Returned description of the problem if an error occurs.
+     * @return True if the state was saved, false otherwise.
+     */
+    bool saveState(const string &path, string &error) const;
+
+    /**
+     * @brief Restores the state saved by <b>saveState()</b>, so after a restart flickering is removed from the first
+     * block instead of after <b>getWarmUpDuration()</b> frames. It should be called right after construction. The
+     * state must be saved by the flicker remover for the camera with the same fps, the same size of frames and
+     * learning scale. The next frame may have any timestamp, the schedule of learning starts over and the overload
+     * policy resumes normal processing.
+     * @param path Path of the file.
+     * @param error Returned description of the problem if an error occurs.
+     * @return True if the state was restored. False if the state does not match this flicker remover, which is not
+     * changed then, or if the file is corrupted, in which case the flicker remover is reset.
+     */
+    bool loadState(const string &path, string &error);
+
     /**
      * @brief Calculates number of frames after which flicker remover starts to remove flickering from frames.
      * @return Number of first frames processed without removing flickering.
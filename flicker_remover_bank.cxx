@@ -0,0 +1,138 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#include "flicker_remover_bank.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+using std::to_string;
+
+FlickerRemoverBank::FlickerRemoverBank(ThreadPool &thread_pool) : thread_pool(thread_pool)
+{
+}
+
+FlickerRemoverBank::~FlickerRemoverBank() = default;
+
+bool FlickerRemoverBank::addStream(unsigned int camera_fps, int flickering_threshold,
+                                   int max_allowed_flicker_duration, int frame_rows, int frame_cols,
+                                   unsigned int &stream, string &error, FrameStorage frame_storage,
+                                   SimilarityCounters similarity_counters, FrameLayout frame_layout,
+                                   MemoryPages memory_pages)
+{
+    std::unique_ptr<Stream> new_stream(new Stream());
+    try {
+        //tiles of frames are processed by the same pool as streams, so threads are never oversubscribed and the
+        //state of the stream is first touched by threads which will process it
+        new_stream->flicker_remover.reset(
+                new FlickerRemoverCPU(camera_fps, flickering_threshold, max_allowed_flicker_duration, frame_rows,
+                                      frame_cols, frame_storage, similarity_counters, frame_layout, &thread_pool, 1,
+                                      memory_pages));
+    } catch(const std::exception &ex) {
+        error = "Stream cannot be added. " + string(ex.what());
+        return false;
+    }
+    new_stream->statistics = StreamStatistics{0, 0, 0, 0, OverloadCounters{0, 0, 0, 0, 0}};
+
+    std::lock_guard<std::mutex> lock(streams_guard);
+    stream = (unsigned int) streams.size();
+    streams.push_back(std::move(new_stream));
+    return true;
+}
+
+bool FlickerRemoverBank::submit(unsigned int stream, const Mat &frame, double timestamp, string &error)
+{
+    std::lock_guard<std::mutex> lock(streams_guard);
+    if(stream >= streams.size()) {
+        error = "Frame cannot be submitted. Unknown stream: " + to_string(stream) + ".";
+        return false;
+    }
+    streams[stream]->pending_frames.push_back(PendingFrame{frame, timestamp, std::chrono::steady_clock::now()});
+    return true;
+}
+
+bool FlickerRemoverBank::setOverloadPolicy(unsigned int stream, const OverloadPolicy &policy, string &error)
+{
+    //processing guard is taken first, so the policy is never changed while the stream is processed
+    std::lock_guard<std::mutex> processing_lock(processing_guard);
+    FlickerRemoverCPU *flicker_remover;
+    {
+        std::lock_guard<std::mutex> lock(streams_guard);
+        if(stream >= streams.size()) {
+            error = "Overload policy cannot be set. Unknown stream: " + to_string(stream) + ".";
+            return false;
+        }
+        flicker_remover = streams[stream]->flicker_remover.get();
+    }
+    return flicker_remover->setOverloadPolicy(policy, error);
+}
+
+void FlickerRemoverBank::processPending(vector<ProcessedFrame> &processed_frames)
+{
+    std::lock_guard<std::mutex> processing_lock(processing_guard);
+
+    //frames are taken from queues at once, so streams can be processed without holding the lock
+    vector<Stream *> batch_streams;
+    vector<std::deque<PendingFrame>> batch_frames;
+    vector<unsigned int> batch_ids;
+    {
+        std::lock_guard<std::mutex> lock(streams_guard);
+        for(unsigned int j = 0; j < streams.size(); j++) {
+            if(streams[j]->pending_frames.empty()) {
+                continue;
+            }
+            batch_streams.push_back(streams[j].get());
+            batch_ids.push_back(j);
+            batch_frames.emplace_back();
+            batch_frames.back().swap(streams[j]->pending_frames);
+        }
+    }
+
+    vector<vector<ProcessedFrame>> results(batch_streams.size());
+    thread_pool.parallelFor((unsigned int) batch_streams.size(), [&](unsigned int begin, unsigned int end) {
+        for(unsigned int j = begin; j < end; j++) {
+            FlickerRemoverCPU &flicker_remover = *batch_streams[j]->flicker_remover;
+            for(const PendingFrame &pending_frame: batch_frames[j]) {
+                ProcessedFrame result{batch_ids[j], pending_frame.timestamp, false, Mat(), string(), 0};
+                flicker_remover.setInputLag(std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - pending_frame.submission_time).count());
+                result.removed = flicker_remover.removeFlickering(pending_frame.frame, pending_frame.timestamp,
+                                                                  result.frame, result.error);
+                result.latency = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - pending_frame.submission_time).count();
+                results[j].push_back(std::move(result));
+            }
+        }
+    });
+
+    processed_frames.clear();
+    std::lock_guard<std::mutex> lock(streams_guard);
+    for(unsigned int j = 0; j < results.size(); j++) {
+        StreamStatistics &statistics = batch_streams[j]->statistics;
+        for(ProcessedFrame &result: results[j]) {
+            statistics.number_of_frames++;
+            statistics.last_latency = result.latency;
+            statistics.average_latency += (result.latency - statistics.average_latency) / statistics.number_of_frames;
+            statistics.max_latency = std::max(statistics.max_latency, result.latency);
+            processed_frames.push_back(std::move(result));
+        }
+        statistics.overload_counters = batch_streams[j]->flicker_remover->getOverloadCounters();
+    }
+}
+
+bool FlickerRemoverBank::getStatistics(unsigned int stream, StreamStatistics &statistics, string &error) const
+{
+    std::lock_guard<std::mutex> lock(streams_guard);
+    if(stream >= streams.size()) {
+        error = "Statistics cannot be returned. Unknown stream: " + to_string(stream) + ".";
+        return false;
+    }
+    statistics = streams[stream]->statistics;
+    return true;
+}
+
+unsigned int FlickerRemoverBank::getNumberOfStreams() const
+{
+    std::lock_guard<std::mutex> lock(streams_guard);
+    return (unsigned int) streams.size();
+}
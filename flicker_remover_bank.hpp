@@ -0,0 +1,199 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#ifndef FLICKER_REMOVER_BANK_HPP
+#define FLICKER_REMOVER_BANK_HPP
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "flicker_remover_cpu.hpp"
+#include "thread_pool.hpp"
+
+using cv::Mat;
+using std::string;
+using std::vector;
+
+/**
+ * @brief Set of FlickerRemoverCPU objects removing flickering from streams of many cameras with one pool of threads.
+ *
+ * Every stream has its own flicker remover, so streams may have different fps and resolutions. Frames of all streams
+ * are submitted to the bank, which queues them, and then all queued frames are processed in one batch. Streams are
+ * processed in parallel by threads of the shared pool, and frames of every stream are processed one after another in
+ * the order of submission. Tiles of frames are processed by the same pool, so with fewer streams than threads idle
+ * threads help with tiles of frames of other streams, and with more streams than threads every thread processes whole
+ * streams without waiting for other threads.
+ */
+class FlickerRemoverBank {
+public:
+    /**
+     * @brief Result of processing of one submitted frame.
+     */
+    struct ProcessedFrame {
+        /**
+         * @brief Identifier of the stream returned by <b>addStream()</b>.
+         */
+        unsigned int stream;
+
+        /**
+         * @brief Timestamp of the submitted frame.
+         */
+        double timestamp;
+
+        /**
+         * @brief True if flickering was removed, false in case of an error.
+         */
+        bool removed;
+
+        /**
+         * @brief Frame with removed flickering. Empty in case of an error or if the frame was dropped by the overload
+         * policy.
+         */
+        Mat frame;
+
+        /**
+         * @brief Description of the problem if an error occurs.
+         */
+        string error;
+
+        /**
+         * @brief Time in milliseconds from submission of the frame to the end of its processing.
+         */
+        double latency;
+    };
+
+    /**
+     * @brief Statistics of latencies of processed frames of one stream. Latency is the time from submission of the
+     * frame to the end of its processing, in milliseconds.
+     */
+    struct StreamStatistics {
+        unsigned long number_of_frames;
+        double last_latency;
+        double average_latency;
+        double max_latency;
+
+        /**
+         * @brief Numbers of times the overload policy of the stream fired.
+         */
+        OverloadCounters overload_counters;
+    };
+
+protected:
+    /**
+     * @brief Frame submitted to the bank, waiting for processing.
+     */
+    struct PendingFrame {
+        Mat frame;
+        double timestamp;
+        std::chrono::steady_clock::time_point submission_time;
+    };
+
+    /**
+     * @brief Flicker remover of one camera with its queue of frames.
+     */
+    struct Stream {
+        std::unique_ptr<FlickerRemoverCPU> flicker_remover;
+        std::deque<PendingFrame> pending_frames;
+        StreamStatistics statistics;
+    };
+
+    /**
+     * @brief Pool of threads processing streams and tiles of their frames. It is not owned by the bank.
+     */
+    ThreadPool &thread_pool;
+
+    /**
+     * @brief Streams indexed with their identifiers.
+     */
+    vector<std::unique_ptr<Stream>> streams;
+
+    /**
+     * @brief Guards <b>streams</b>, queues of pending frames and statistics, so frames can be submitted from many
+     * threads, also while other frames are processed.
+     */
+    mutable std::mutex streams_guard;
+
+    /**
+     * @brief Guards processing, so only one batch is processed at a time.
+     */
+    std::mutex processing_guard;
+
+public:
+    /**
+     * @brief Constructor.
+     * @param thread_pool Pool of threads processing frames. It must outlive the bank and it may be shared with other
+     * objects.
+     */
+    explicit FlickerRemoverBank(ThreadPool &thread_pool);
+
+    /**
+     * @brief Default destructor.
+     */
+    virtual ~FlickerRemoverBank();
+
+    /**
+     * @brief Adds the stream of frames of one camera with its own flicker remover. See <b>FlickerRemoverCPU</b> for
+     * the description of parameters of the flicker remover.
+     * @param stream Returned identifier of the new stream.
+     * @param error Returned description of the problem if an error occurs.
+     * @return True if the stream was added, false otherwise.
+     */
+    bool addStream(unsigned int camera_fps, int flickering_threshold, int max_allowed_flicker_duration,
+                   int frame_rows, int frame_cols, unsigned int &stream, string &error,
+                   FrameStorage frame_storage = FrameStorage::WIDE,
+                   SimilarityCounters similarity_counters = SimilarityCounters::BYTES,
+                   FrameLayout frame_layout = FrameLayout::PLANAR,
+                   MemoryPages memory_pages = MemoryPages::NORMAL);
+
+    /**
+     * @brief Queues the frame of the stream for processing. It may be called from many threads. The frame is not
+     * copied (Mat is reference counted), so its pixels must not be changed until it is processed.
+     * @param stream Identifier of the stream.
+     * @param frame Frame from which flickering will be removed.
+     * @param timestamp Timestamp of the frame. See <b>FlickerRemoverCPU::removeFlickering()</b>.
+     * @param error Returned description of the problem if an error occurs.
+     * @return True if the frame was queued, false otherwise.
+     */
+    bool submit(unsigned int stream, const Mat &frame, double timestamp, string &error);
+
+    /**
+     * @brief Sets the policy of the stream for frames waiting in its queue for too long. The lag reported to the
+     * flicker remover for every frame is the time from its submission to the start of its processing. See
+     * <b>FlickerRemoverCPU::setOverloadPolicy()</b>.
+     * @param stream Identifier of the stream.
+     * @param policy New policy.
+     * @param error Returned description of the problem if an error occurs.
+     * @return True if the policy was set, false otherwise.
+     */
+    bool setOverloadPolicy(unsigned int stream, const OverloadPolicy &policy, string &error);
+
+    /**
+     * @brief Processes all frames queued so far. Streams are processed in parallel, frames of one stream in the order
+     * of submission. Frames submitted during processing are left for the next call.
+     * @param processed_frames Returned results of processing, grouped by streams and ordered by submission inside
+     * every stream.
+     */
+    void processPending(vector<ProcessedFrame> &processed_frames);
+
+    /**
+     * @brief Returns statistics of latencies of processed frames of the stream.
+     * @param stream Identifier of the stream.
+     * @param statistics Returned statistics.
+     * @param error Returned description of the problem if an error occurs.
+     * @return True if statistics were returned, false otherwise.
+     */
+    bool getStatistics(unsigned int stream, StreamStatistics &statistics, string &error) const;
+
+    /**
+     * @brief Number of streams.
+     */
+    [[nodiscard]] unsigned int getNumberOfStreams() const;
+};
+
+
+#endif //FLICKER_REMOVER_BANK_HPP
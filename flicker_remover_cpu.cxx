@@ -3,6 +3,9 @@
 //
 
 #include "flicker_remover_cpu.hpp"
+#include <algorithm>
+#include <cstring>
+#include "state_file.hpp"
 
 using namespace cv;
 
@@ -11,16 +14,103 @@ using std::to_string;
 
 const double FlickerRemoverCPU::FIRST_TIMESTAMP = -1;
 
+const unsigned int FlickerRemoverCPU::TILE_SIZE = 4096;
+
+namespace {
+/**
+ * @brief Checks if the buffer of the frame is referenced by other Mat headers, for example by frames still held by the
+ * caller of <b>FlickerRemoverCPU::removeFlickering()</b>.
+ */
+bool isShared(const Mat &frame)
+{
+    return frame.u != nullptr && frame.u->refcount > 1;
+}
+
+/**
+ * @brief Returns the header of the same pixels which does not count references to them, like a header of external data.
+ * The buffer must outlive the view.
+ */
+Mat unownedView(const Mat &frame)
+{
+    return Mat(frame.rows, frame.cols, frame.type(), frame.data, frame.step);
+}
+
+/**
+ * @brief Returns plane of pixels of the historical frame or mask. Continuous matrices are single planes, views of
+ * interleaved storage have one lane group per row.
+ */
+template<typename T>
+PixelPlane<T> pixelPlane(const Mat &frame)
+{
+    return PixelPlane<T>((T *) frame.data, frame.isContinuous() ? PixelPlane<T>::LANES : (unsigned int) frame.step1());
+}
+
+/**
+ * @brief Kind and version of the format of saved states.
+ */
+const char STATE_KIND[] = "FlickerRemoverCPU";
+const uint32_t STATE_VERSION = 1;
+
+/**
+ * @brief Writes pixels of the range of the historical frame or mask in the order of linear indexes, so the state does
+ * not depend on the layout. The range must start at the multiple of <b>PixelPlane::LANES</b>.
+ */
+template<typename T>
+void writePlane(StateWriter &writer, const Mat &frame, unsigned int begin, unsigned int end)
+{
+    const PixelPlane<const T> plane = pixelPlane<const T>(frame);
+    for(unsigned int i = begin; i < end; i += PixelPlane<const T>::LANES) {
+        writer.write(plane.ptr(i), std::min(PixelPlane<const T>::LANES, end - i) * sizeof(T));
+    }
+}
+
+/**
+ * @brief Reads pixels of the historical frame or mask written by <b>writePlane()</b>.
+ */
+template<typename T>
+void readPlane(StateReader &reader, const Mat &frame, unsigned int length)
+{
+    const PixelPlane<T> plane = pixelPlane<T>(frame);
+    for(unsigned int i = 0; i < length; i += PixelPlane<T>::LANES) {
+        reader.read(plane.ptr(i), std::min(PixelPlane<T>::LANES, length - i) * sizeof(T));
+    }
+}
+
+/**
+ * @brief Returns size of frames from which masks are learnt.
+ * @param size Height or width of processed frames.
+ * @param learning_scale Factor by which frames are downsampled for learning.
+ */
+int learningSize(int size, unsigned int learning_scale)
+{
+    if(learning_scale != 1 && learning_scale != 2 && learning_scale != 4) {
+        throw std::runtime_error("Learning scale must be equal to 1, 2 or 4.");
+    }
+    if(size % (int) learning_scale != 0) {
+        throw std::runtime_error("Size of frames must be a multiple of the learning scale.");
+    }
+    return size / (int) learning_scale;
+}
+}
+
 
 FlickerRemoverCPU::FlickerRemoverCPU(unsigned int camera_fps, int flickering_threshold,
-                                     int max_allowed_flicker_duration, int frame_rows, int frame_cols)
-        : frame_rows(frame_rows), frame_cols(frame_cols),
+                                     int max_allowed_flicker_duration, int frame_rows, int frame_cols,
+                                     FrameStorage frame_storage, SimilarityCounters similarity_counters,
+                                     FrameLayout frame_layout, ThreadPool *thread_pool, unsigned int learning_scale,
+                                     MemoryPages memory_pages)
+        : frame_rows(frame_rows), frame_cols(frame_cols), learning_scale(learning_scale),
+          learning_rows(learningSize(frame_rows, learning_scale)),
+          learning_cols(learningSize(frame_cols, learning_scale)),
           expected_timestamp(FIRST_TIMESTAMP), timestamps_delta(1000.0 / camera_fps),
           accepted_timestamp_difference(timestamps_delta / 3), frames_block(0),
-          flicker_counter(frame_rows, frame_cols, CV_8U, Scalar(0)), flickering_threshold(flickering_threshold),
+          corresponding_frames_similarity_counter(nullptr), adjacent_frames_similarity_counter(nullptr),
+          counting_pixels(nullptr), zero_levels(nullptr), stale_corresponding_levels(0), stale_adjacent_levels(0),
+          history_epoch(0), masks_epoch(0), flickering_threshold(flickering_threshold),
           max_allowed_flicker_duration(max_allowed_flicker_duration), corresponding_frames_similarity_levels(0),
-          corresponding_frames_similarity_sum(frame_rows, frame_cols, CV_8U, Scalar(0)),
-          adjacent_frames_similarity_levels(0), adjacent_frames_similarity_sum(frame_rows, frame_cols, CV_8U, Scalar(0))
+          adjacent_frames_similarity_levels(0), frame_storage(frame_storage),
+          similarity_counters(similarity_counters), frame_layout(frame_layout), thread_pool(thread_pool),
+          learning_scheduler(0)
 {
     //calculate number of masks
     const unsigned int current_frequency = 50;
@@ -41,43 +131,223 @@ FlickerRemoverCPU::FlickerRemoverCPU(unsigned int camera_fps, int flickering_thr
     }
     number_of_masks = count - 1;
     block_size = count;
+    //sums are integral, so sum > 0.7 * block_size is the same as sum >= floor(0.7 * block_size) + 1
+    min_similar_blocks = (unsigned int) std::floor(0.7 * block_size) + 1;
     frames_block.setMaxSize(block_size);
+    frame_views.block_frames.resize(block_size);
+    learning_scheduler.setBlockSize(block_size);
+    const auto length = (unsigned int) (learning_rows * learning_cols);
+    const unsigned int number_of_tiles = (length + TILE_SIZE - 1) / TILE_SIZE;
+    refined_tiles.assign(number_of_tiles, 0);
+    tile_history_epochs.assign(number_of_tiles, history_epoch);
+    tile_masks_epochs.assign(number_of_tiles, masks_epoch);
+
+    //planes are reserved first, so the whole state is allocated at once
+    const size_t pixel_size = frame_storage == FrameStorage::NARROW ? sizeof(unsigned char) : sizeof(int);
+    const size_t mask_size = frame_storage == FrameStorage::NARROW ? sizeof(short) : sizeof(int);
+    const int lanes = (int) PixelPlane<int>::LANES;
+    const int number_of_groups = ((int) length + lanes - 1) / lanes;
+    unsigned int masks_plane;
+    unsigned int frames_plane = 0;
+    if(frame_layout == FrameLayout::INTERLEAVED) {
+        //tiles consist of whole groups of lanes, so every tile of the interleaved storage is continuous
+        masks_plane = arena.reserve(number_of_groups * lanes * number_of_masks * mask_size,
+                                    TILE_SIZE * number_of_masks * mask_size);
+        frames_plane = arena.reserve(number_of_groups * lanes * (block_size + 1) * pixel_size,
+                                     TILE_SIZE * (block_size + 1) * pixel_size);
+    } else {
+        masks_plane = arena.reserve(length * mask_size, TILE_SIZE * mask_size);
+        for(unsigned int j = 1; j < number_of_masks; j++) {
+            arena.reserve(length * mask_size, TILE_SIZE * mask_size);
+        }
+        if(learning_scale > 1) {
+            //downsampled frames are never returned to the caller
+            frames_plane = arena.reserve(length * pixel_size, TILE_SIZE * pixel_size);
+            for(unsigned int j = 1; j < block_size + 1; j++) {
+                arena.reserve(length * pixel_size, TILE_SIZE * pixel_size);
+            }
+        }
+    }
+    const unsigned int flicker_counter_plane = arena.reserve(length, TILE_SIZE);
+    unsigned int sums_plane = 0;
+    unsigned int counters_plane = 0;
+    if(similarity_counters == SimilarityCounters::BIT_SLICED) {
+        const size_t tile_words = TILE_SIZE / 64 * sizeof(uint64_t);
+        counters_plane = arena.reserve(BitSlicedCounter::getSize(length, block_size),
+                                       tile_words * BitSlicedCounter::getNumberOfPlanes(block_size));
+        arena.reserve(BitSlicedCounter::getSize(length, block_size - 1),
+                      tile_words * BitSlicedCounter::getNumberOfPlanes(block_size - 1));
+    } else {
+        sums_plane = arena.reserve(length, TILE_SIZE);
+        arena.reserve(length, TILE_SIZE);
+    }
+    //counting pixels, zero levels, levels of both buffers and spare levels
+    const size_t levels_size = BooleanArray2D::getSize((unsigned int) learning_rows, (unsigned int) learning_cols);
+    const unsigned int words_plane = arena.reserve(levels_size, TILE_SIZE / 64 * sizeof(uint64_t));
+    for(unsigned int j = 1; j < 2 * block_size + 3; j++) {
+        arena.reserve(levels_size, TILE_SIZE / 64 * sizeof(uint64_t));
+    }
+    arena.allocate(memory_pages);
+
+    //every tile is zeroed by the thread which processes it, so its pages are allocated on the node of this thread
+    auto touch_tiles = [this](unsigned int first_tile, unsigned int end_tile) {
+        arena.touchTiles(first_tile, end_tile);
+    };
+    if(thread_pool != nullptr) {
+        thread_pool->parallelFor(number_of_tiles, touch_tiles);
+    } else {
+        parallel_for_(Range(0, (int) number_of_tiles), [&touch_tiles](const Range &range) {
+            touch_tiles((unsigned int) range.start, (unsigned int) range.end);
+        });
+    }
+
     masks.reserve(number_of_masks);
-    for(unsigned int j = 0; j < number_of_masks; j++) {
-        masks.emplace_back(frame_rows, frame_cols, CV_32S, Scalar(0));
+    //one more buffer than frames in the block, so the new frame can be written while the oldest one is still needed
+    frame_pool.reserve(block_size + 1);
+    if(frame_layout == FrameLayout::INTERLEAVED) {
+        interleaved_masks = Mat(number_of_groups, (int) number_of_masks * lanes, getMaskType(),
+                                arena.getPlane(masks_plane));
+        for(unsigned int j = 0; j < number_of_masks; j++) {
+            masks.push_back(interleaved_masks.colRange((int) j * lanes, (int) (j + 1) * lanes));
+        }
+        interleaved_frames = Mat(number_of_groups, (int) (block_size + 1) * lanes, getFrameType(),
+                                 arena.getPlane(frames_plane));
+        for(unsigned int j = 0; j < block_size + 1; j++) {
+            frame_pool.push_back(interleaved_frames.colRange((int) j * lanes, (int) (j + 1) * lanes));
+        }
+    } else {
+        for(unsigned int j = 0; j < number_of_masks; j++) {
+            masks.emplace_back(learning_rows, learning_cols, getMaskType(), arena.getPlane(masks_plane + j));
+        }
+        for(unsigned int j = 0; j < block_size + 1; j++) {
+            if(learning_scale > 1) {
+                frame_pool.emplace_back(learning_rows, learning_cols, getFrameType(), arena.getPlane(frames_plane + j));
+            } else {
+                frame_pool.emplace_back(learning_rows, learning_cols, getFrameType());
+            }
+        }
     }
+    if(frame_layout == FrameLayout::INTERLEAVED || learning_scale > 1) {
+        output_frame = Mat(frame_rows, frame_cols, getFrameType());
+    }
+    flicker_counter = Mat(learning_rows, learning_cols, CV_8U, arena.getPlane(flicker_counter_plane));
+    if(similarity_counters == SimilarityCounters::BIT_SLICED) {
+        corresponding_frames_similarity_counter = new BitSlicedCounter(length, block_size,
+                                                                       arena.getPlane<uint64_t>(counters_plane));
+        adjacent_frames_similarity_counter = new BitSlicedCounter(length, block_size - 1,
+                                                                  arena.getPlane<uint64_t>(counters_plane + 1));
+    } else {
+        corresponding_frames_similarity_sum = Mat(learning_rows, learning_cols, CV_8U, arena.getPlane(sums_plane));
+        adjacent_frames_similarity_sum = Mat(learning_rows, learning_cols, CV_8U, arena.getPlane(sums_plane + 1));
+    }
+    counting_pixels = new BooleanArray2D((unsigned int) learning_rows, (unsigned int) learning_cols,
+                                         arena.getPlane<uint64_t>(words_plane));
+    zero_levels = new BooleanArray2D((unsigned int) learning_rows, (unsigned int) learning_cols,
+                                     arena.getPlane<uint64_t>(words_plane + 1));
     actual_mask = number_of_masks;
+    spare_frame = takeFromFramePool();
     corresponding_frames_similarity_levels.setMaxSize(block_size);
     adjacent_frames_similarity_levels.setMaxSize(block_size - 1);
-    for(unsigned int j = 0; j < block_size; j++) {
-        corresponding_frames_similarity_levels.push(
-                new BooleanArray2D((unsigned int) frame_rows, (unsigned int) frame_cols));
-    }
-    for(unsigned int j = 0; j < block_size - 1; j++) {
-        adjacent_frames_similarity_levels.push(
-                new BooleanArray2D((unsigned int) frame_rows, (unsigned int) frame_cols));
-    }
+    allocateSimilarityLevels(words_plane + 2);
 }
 
 FlickerRemoverCPU::~FlickerRemoverCPU()
 {
     clear();
+    delete corresponding_frames_similarity_counter;
+    delete adjacent_frames_similarity_counter;
+    delete counting_pixels;
+    delete zero_levels;
+}
+
+bool FlickerRemoverCPU::removeFlickering(const Mat &frame, double timestamp, Mat &frame_without_flickering,
+                                         string &error)
+{
+    FrameUpdate update{};
+    bool dropped = false;
+    if(!prepareFrame(frame, timestamp, update, frame_views, frame_without_flickering, dropped, error)) {
+        return false;
+    }
+    if(dropped) {
+        return true;
+    }
+    if(learning_scale > 1) {
+        //history is not updated while learning is stopped, then the mask is only applied to the frame
+        if(isLearning()) {
+            updateFrames(&update, 1);
+        }
+        //the mask is applied after learning, so masks refined at the end of the block already apply to this frame
+        applyUpsampledMask(frame, update.mask);
+    } else {
+        updateFrames(&update, 1);
+    }
+    return true;
+}
+
+bool FlickerRemoverCPU::processBatch(const vector<Mat> &frames, const vector<double> &timestamps,
+                                     vector<Mat> &frames_without_flickering, string &error)
+{
+    if(frames.size() != timestamps.size()) {
+        error = "Batch cannot be processed. Number of frames: " + to_string(frames.size()) +
+                " is different than number of timestamps: " + to_string(timestamps.size()) + ".";
+        return false;
+    }
+    frames_without_flickering.assign(frames.size(), Mat());
+    if(learning_scale > 1) {
+        //masks are applied at full resolution after learning, which is not done tile by tile
+        for(size_t k = 0; k < frames.size(); k++) {
+            if(!removeFlickering(frames[k], timestamps[k], frames_without_flickering[k], error)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //all frames are prepared first, buffers are recycled like with sequential calls, so later frames may write to
+    //buffers read by earlier ones, but every tile is processed by frames in their order
+    vector<FrameUpdate> updates;
+    vector<FrameViews> views;
+    //views are referenced by updates, so they are never reallocated
+    updates.reserve(frames.size());
+    views.reserve(frames.size());
+    bool prepared = true;
+    for(size_t k = 0; k < frames.size(); k++) {
+        FrameUpdate update{};
+        views.emplace_back();
+        bool dropped = false;
+        if(!prepareFrame(frames[k], timestamps[k], update, views.back(), frames_without_flickering[k], dropped,
+                         error)) {
+            error = "Frame " + to_string(k) + " of the batch: " + error;
+            prepared = false;
+            break;
+        }
+        if(!dropped) {
+            updates.push_back(update);
+        }
+    }
+    updateFrames(updates.data(), (unsigned int) updates.size());
+    return prepared;
 }
 
-Mat *FlickerRemoverCPU::removeFlickering(const Mat &frame, double timestamp, string &error)
+bool FlickerRemoverCPU::prepareFrame(const Mat &frame, double timestamp, FrameUpdate &update, FrameViews &views,
+                                     Mat &frame_without_flickering, bool &dropped, string &error)
 {
     if(frame.rows != frame_rows || frame.cols != frame_cols) {
         error = "Flickering cannot be removed. Size of the frame: " + to_string(frame.cols) + "x" +
                 to_string(frame.rows) + " is different than expected: " + to_string(frame_cols) + "x" +
                 to_string(frame_rows) + ".";
-        return nullptr;
+        return false;
+    }
+    if(frame.type() != CV_8UC1) {
+        error = "Flickering cannot be removed. Frame must have 1 channel with unsigned char pixels.";
+        return false;
     }
     if(!timestampIsCloseToExpectedTimestamp(timestamp)) {
         //very unlikely. Should not happen...
         if(timestamp < expected_timestamp) {
             error = "Received unexpected timestamp: " + to_string(timestamp) + " Expected value close to: " +
                     to_string(expected_timestamp);
-            return nullptr;
+            return false;
         }
         //calculate number of frames that were dropped
         auto number_of_dropped = (unsigned int) ((timestamp - expected_timestamp + accepted_timestamp_difference) /
@@ -87,100 +357,328 @@ Mat *FlickerRemoverCPU::removeFlickering(const Mat &frame, double timestamp, str
     }
     calculateNextExpectedTimestamp(timestamp);
 
-    auto frame_copy = new Mat();
+    //position of the frame in the block, the first frame of the block has no mask applied
+    const unsigned int position = actual_mask == number_of_masks ? 0 : actual_mask + 1;
+    if(load_shedder.nextFrame(position)) {
+        clearHistory();
+    }
+    if(load_shedder.getAction() == OverloadAction::DROP_BLOCK) {
+        //the mask phase advances as if the frame was processed, so the next block starts with its first frame
+        actual_mask = actual_mask == number_of_masks ? 0 : actual_mask + 1;
+        frame_without_flickering.release();
+        dropped = true;
+        return true;
+    }
+    if(learning_scheduler.nextFrame(position, [&frame]() {
+        return mean(frame)[0];
+    })) {
+        clearHistory();
+    }
 
+    update.frame = &frame;
+    update.history_epoch = history_epoch;
+    if(learning_scale > 1 || frame_layout == FrameLayout::INTERLEAVED) {
+        //historical frames never leave this class, the result is written to the separate buffer
+        if(isShared(output_frame)) {
+            output_frame = Mat(frame_rows, frame_cols, getFrameType());
+        }
+        if(learning_scale == 1) {
+            views.output_frame = unownedView(output_frame);
+            update.output_frame = &views.output_frame;
+        }
+    } else if(isShared(spare_frame)) {
+        //the caller still holds this frame, so leave it to the caller and use a new buffer in its place
+        spare_frame = Mat(learning_rows, learning_cols, getFrameType());
+    }
+    views.frame_copy = unownedView(spare_frame);
+    update.frame_copy = &views.frame_copy;
     if(actual_mask == number_of_masks) {
         actual_mask = 0;
-        frame.convertTo(*frame_copy, CV_32S);
+        update.mask = nullptr;
     } else {
-        subtract(frame, masks[actual_mask], *frame_copy, noArray(), CV_32S);
+        update.mask = &masks[actual_mask];
         actual_mask++;
     }
 
-    auto last_frame = frames_block.last();
-    if(last_frame != nullptr) {
-        auto new_similarity_levels = new BooleanArray2D((unsigned int) frame_rows, (unsigned int) frame_cols);
-        auto old_similarity_levels = adjacent_frames_similarity_levels.push(new_similarity_levels);
-
-        last_frame->forEach<int>(
-                [this, &frame_copy, new_similarity_levels, old_similarity_levels](int &value, const int *position) {
-                    int row = position[0];
-                    int col = position[1];
-                    bool pixels_are_similar = similar(value, frame_copy->at<int>(row, col));
-                    new_similarity_levels->set((unsigned int) row, (unsigned int) col, pixels_are_similar);
-                    adjacent_frames_similarity_sum.at<unsigned char>(row, col) +=
-                            (unsigned char) pixels_are_similar -
-                            (unsigned char) old_similarity_levels->at((unsigned int) row, (unsigned int) col);
-                });
-        delete old_similarity_levels;
-    }
-
-    //push returns pointer to the allocated earlier matrix, but do not delete, since we already returned this pointer
-    //outside of this method, and it is the responsibility of the caller to delete this pointer.
-    auto prev_frame = frames_block.push(frame_copy);
-
-    if(prev_frame != nullptr) {
-        auto new_similarity_levels = new BooleanArray2D((unsigned int) frame_rows, (unsigned int) frame_cols);
-        auto old_similarity_levels = corresponding_frames_similarity_levels.push(new_similarity_levels);
-        prev_frame->forEach<int>(
-                [this, &frame_copy, new_similarity_levels, old_similarity_levels](int &value, const int *position) {
-                    int row = position[0];
-                    int col = position[1];
-                    bool pixels_are_similar = similar(value, frame_copy->at<int>(row, col));
-                    new_similarity_levels->set((unsigned int) row, (unsigned int) col, pixels_are_similar);
-                    corresponding_frames_similarity_sum.at<unsigned char>(row, col) +=
-                            (unsigned char) pixels_are_similar -
-                            (unsigned char) old_similarity_levels->at((unsigned int) row, (unsigned int) col);
-                });
-        delete old_similarity_levels;
-    }
-
-    if(actual_mask == number_of_masks && frames_block.isFull()) {
-        flicker_counter.forEach<unsigned char>([this, &frame_copy](unsigned char &value, const int *position) {
-            int row = position[0];
-            int col = position[1];
-            if(corresponding_frames_similarity_sum.at<unsigned char>(row, col) > 0.7 * block_size) {
-                bool values_similar = true;
-                unsigned int block_number = 0;
-                while(values_similar && block_number + 1 < frames_block.maxSize()) {
-                    values_similar = similar(frames_block[(int) block_number]->at<int>(row, col),
-                                             frames_block[(int) block_number + 1]->at<int>(row, col));
-                    block_number++;
-                }
-                if(!values_similar) {
-                    value++;
+    if(!isLearning()) {
+        //history is not updated, so the spare buffer only holds the frame with the mask applied
+        if(learning_scale > 1 || frame_layout == FrameLayout::INTERLEAVED) {
+            frame_without_flickering = output_frame;
+        } else {
+            frame_without_flickering = spare_frame;
+        }
+        return true;
+    }
+
+    if(learning_scale > 1) {
+        //box filter, so every pixel of the learning frame is the mean of one block of pixels of the frame
+        resize(frame, learning_frame, Size(learning_cols, learning_rows), 0, 0, INTER_AREA);
+        update.frame = &learning_frame;
+    }
+
+    //all internal buffers are rotated first, so then the whole frame can be processed in one pass over tiles
+    if(!frames_block.isEmpty()) {
+        views.last_frame = unownedView(frames_block.last());
+        update.last_frame = &views.last_frame;
+        update.new_adjacent_levels = spare_adjacent_levels;
+        //the oldest levels are recycled as spare levels, they are read by this frame before the next frame
+        //overwrites them
+        spare_adjacent_levels = adjacent_frames_similarity_levels.push(spare_adjacent_levels);
+        update.old_adjacent_levels = spare_adjacent_levels;
+        if(stale_adjacent_levels > 0) {
+            //levels stored before the history was cleared are not in sums anymore
+            stale_adjacent_levels--;
+            update.old_adjacent_levels = zero_levels;
+        }
+    }
+
+    //push returns the oldest frame, which is recycled as the spare buffer for the next frame
+    Mat prev_frame = frames_block.push(std::move(spare_frame));
+    views.frame_copy = unownedView(frames_block.last());
+    if(!prev_frame.empty()) {
+        views.prev_frame = unownedView(prev_frame);
+        update.prev_frame = &views.prev_frame;
+        update.new_corresponding_levels = spare_corresponding_levels;
+        spare_corresponding_levels = corresponding_frames_similarity_levels.push(spare_corresponding_levels);
+        update.old_corresponding_levels = spare_corresponding_levels;
+        if(stale_corresponding_levels > 0) {
+            stale_corresponding_levels--;
+            update.old_corresponding_levels = zero_levels;
+        }
+        spare_frame = std::move(prev_frame);
+    } else {
+        //frames block is not full yet, so take the next unused buffer
+        spare_frame = takeFromFramePool();
+    }
+
+    update.block_end = actual_mask == number_of_masks && frames_block.isFull();
+    if(update.block_end) {
+        views.block_frames.resize(block_size);
+        for(unsigned int j = 0; j < block_size; j++) {
+            views.block_frames[j] = unownedView(frames_block[(int) j]);
+        }
+        update.block_frames = views.block_frames.data();
+    }
+
+    if(learning_scale > 1 || frame_layout == FrameLayout::INTERLEAVED) {
+        frame_without_flickering = output_frame;
+    } else {
+        frame_without_flickering = frames_block.last();
+    }
+    return true;
+}
+
+void FlickerRemoverCPU::updateFrames(const FrameUpdate *updates, unsigned int number_of_updates)
+{
+    if(number_of_updates == 0) {
+        return;
+    }
+    const auto length = (unsigned int) (learning_rows * learning_cols);
+    const unsigned int number_of_tiles = (length + TILE_SIZE - 1) / TILE_SIZE;
+    auto update_tiles = [this, updates, number_of_updates, length](unsigned int first_tile, unsigned int end_tile) {
+        for(unsigned int tile = first_tile; tile < end_tile; tile++) {
+            unsigned int begin = tile * TILE_SIZE;
+            unsigned int end = std::min(length, begin + TILE_SIZE);
+            for(unsigned int k = 0; k < number_of_updates; k++) {
+                if(frame_storage == FrameStorage::NARROW) {
+                    updateTile<unsigned char, short>(updates[k], begin, end);
                 } else {
-                    value = 0;
+                    updateTile<int, int>(updates[k], begin, end);
                 }
+            }
+        }
+    };
+    if(thread_pool != nullptr) {
+        thread_pool->parallelFor(number_of_tiles, update_tiles);
+    } else {
+        parallel_for_(Range(0, (int) number_of_tiles), [&update_tiles](const Range &range) {
+            update_tiles((unsigned int) range.start, (unsigned int) range.end);
+        });
+    }
+}
+
+void FlickerRemoverCPU::applyUpsampledMask(const Mat &frame, const Mat *mask)
+{
+    auto apply_rows = [this, &frame, mask](unsigned int first_row, unsigned int end_row) {
+        if(frame_storage == FrameStorage::NARROW) {
+            applyUpsampledMaskToRows<unsigned char, short>(frame, mask, first_row, end_row);
+        } else {
+            applyUpsampledMaskToRows<int, int>(frame, mask, first_row, end_row);
+        }
+    };
+    //every range covers whole blocks of rows which share one row of the mask
+    const auto number_of_learning_rows = (unsigned int) learning_rows;
+    if(thread_pool != nullptr) {
+        thread_pool->parallelFor(number_of_learning_rows, [this, &apply_rows](unsigned int begin, unsigned int end) {
+            apply_rows(begin * learning_scale, end * learning_scale);
+        });
+    } else {
+        parallel_for_(Range(0, (int) number_of_learning_rows), [this, &apply_rows](const Range &range) {
+            apply_rows((unsigned int) range.start * learning_scale, (unsigned int) range.end * learning_scale);
+        });
+    }
+}
+
+template<typename PixelT, typename MaskT>
+void FlickerRemoverCPU::applyUpsampledMaskToRows(const Mat &frame, const Mat *mask, unsigned int first_row,
+                                                 unsigned int end_row)
+{
+    const PixelPlane<const MaskT> mask_plane = mask != nullptr ? pixelPlane<const MaskT>(*mask) :
+                                               PixelPlane<const MaskT>();
+    for(unsigned int row = first_row; row < end_row; row++) {
+        const auto *src = frame.ptr<unsigned char>((int) row);
+        auto *dst = output_frame.ptr<PixelT>((int) row);
+        const unsigned int learning_row_begin = row / learning_scale * (unsigned int) learning_cols;
+        for(unsigned int col = 0; col < (unsigned int) learning_cols; col++) {
+            const unsigned int i = learning_row_begin + col;
+            //masks of tiles without refined pixels are zero
+            const int value = mask_plane.data != nullptr && refined_tiles[i / TILE_SIZE] != 0 ? (int) mask_plane[i] : 0;
+            for(unsigned int k = col * learning_scale; k < (col + 1) * learning_scale; k++) {
+                //results are saturated only for narrow storage, like when masks are applied at full resolution
+                dst[k] = saturate_cast<PixelT>((int) src[k] - value);
+            }
+        }
+    }
+}
+
+template<typename PixelT, typename MaskT>
+void FlickerRemoverCPU::updateTile(const FrameUpdate &update, unsigned int begin, unsigned int end)
+{
+    const Mat &frame = *update.frame;
+    clearStaleTileHistory(update.history_epoch, begin, end);
+    //masks of tiles without refined pixels are zero, so frames are only converted there
+    const PixelPlane<const MaskT> mask = update.mask != nullptr && refined_tiles[begin / TILE_SIZE] != 0 ?
+                                         pixelPlane<const MaskT>(*update.mask) : PixelPlane<const MaskT>();
+    const PixelPlane<PixelT> frame_copy = pixelPlane<PixelT>(*update.frame_copy);
+
+    if(frame.isContinuous()) {
+        CPUKernels::applyMask(frame.ptr<unsigned char>(), mask, begin, end, frame_copy);
+    } else {
+        for(unsigned int row = begin / learning_cols; row * learning_cols < end; row++) {
+            unsigned int row_begin = std::max(begin, row * learning_cols);
+            unsigned int row_end = std::min(end, (row + 1) * learning_cols);
+            CPUKernels::applyMask(frame.ptr<unsigned char>((int) row) - row * learning_cols, mask, row_begin, row_end,
+                                  frame_copy);
+        }
+    }
+
+    //words of flags of the tile, begin is a multiple of 64
+    const unsigned int begin_word = begin / 64;
+    const unsigned int end_word = (end + 63) / 64;
+    const bool bit_sliced = similarity_counters == SimilarityCounters::BIT_SLICED;
+
+    if(update.last_frame != nullptr) {
+        CPUKernels::updateSimilarityLevels(pixelPlane<const PixelT>(*update.last_frame), frame_copy, begin, end,
+                                           flickering_threshold, update.old_adjacent_levels->getWords(),
+                                           update.new_adjacent_levels->getWords(),
+                                           bit_sliced ? nullptr : adjacent_frames_similarity_sum.ptr<unsigned char>());
+        if(bit_sliced) {
+            adjacent_frames_similarity_counter->update(begin_word, end_word, update.new_adjacent_levels->getWords(),
+                                                       update.old_adjacent_levels->getWords());
+        }
+    }
+
+    if(update.prev_frame != nullptr) {
+        CPUKernels::updateSimilarityLevels(pixelPlane<const PixelT>(*update.prev_frame), frame_copy, begin, end,
+                                           flickering_threshold, update.old_corresponding_levels->getWords(),
+                                           update.new_corresponding_levels->getWords(),
+                                           bit_sliced ? nullptr :
+                                           corresponding_frames_similarity_sum.ptr<unsigned char>());
+        if(bit_sliced) {
+            corresponding_frames_similarity_counter->update(begin_word, end_word,
+                                                            update.new_corresponding_levels->getWords(),
+                                                            update.old_corresponding_levels->getWords());
+        }
+    }
+
+    if(update.block_end) {
+        AutoBuffer<PixelPlane<const PixelT>, 64> block_frames(block_size);
+        for(unsigned int j = 0; j < block_size; j++) {
+            block_frames[j] = pixelPlane<const PixelT>(update.block_frames[j]);
+        }
+        AutoBuffer<PixelPlane<MaskT>, 64> block_masks(number_of_masks);
+        for(unsigned int j = 0; j < number_of_masks; j++) {
+            block_masks[j] = pixelPlane<MaskT>(masks[j]);
+        }
+        //one word per 64 pixels, so the default tile fits into the internal buffers
+        const unsigned int number_of_words = end_word - begin_word;
+        AutoBuffer<uint64_t, 64> flickering(number_of_words);
+        AutoBuffer<uint64_t, 64> static_pixels(number_of_words);
+        if(bit_sliced) {
+            corresponding_frames_similarity_counter->greaterOrEqual(begin_word, end_word, min_similar_blocks,
+                                                                    flickering.data());
+        } else {
+            CPUKernels::findCandidates(corresponding_frames_similarity_sum.ptr<unsigned char>(), min_similar_blocks,
+                                       begin, end, flickering.data());
+        }
+        //only candidates can flicker, so static pixels are not needed in tiles without candidates
+        uint64_t candidate_words = 0;
+        for(unsigned int j = 0; j < number_of_words; j++) {
+            candidate_words |= flickering[j];
+        }
+        if(candidate_words != 0) {
+            if(bit_sliced) {
+                adjacent_frames_similarity_counter->equal(begin_word, end_word, number_of_masks,
+                                                          static_pixels.data());
             } else {
-                value = 0;
+                CPUKernels::findStaticPixels(adjacent_frames_similarity_sum.ptr<unsigned char>(), number_of_masks,
+                                             begin, end, static_pixels.data());
             }
-            if(value > max_allowed_flicker_duration) {
-                for(int i = 0; i < (int) number_of_masks; i++) {
-                    masks[i].at<int>(row, col) +=
-                            frames_block[i + 1]->at<int>(row, col) - frames_block[0]->at<int>(row, col);
-                }
-                value = 0;
-                //subtract mask from frame copy, but be sure that result is between 0-255
-                auto mask_val = masks[number_of_masks - 1].at<int>(row, col);
-                auto &frame_copy_val = frame_copy->at<int>(row, col);
-                if(mask_val >= 0) {
-                    if(frame_copy_val >= mask_val) {
-                        frame_copy_val -= mask_val;
-                    } else {
-                        frame_copy_val = 0;
-                    }
-                } else {
-                    if((int) frame_copy_val - mask_val > 255) {
-                        frame_copy_val = 255;
-                    } else {
-                        frame_copy_val -= mask_val;
-                    }
+            //adjacent similarity levels hold exactly the pairs of adjacent frames of the block, so the pixel was
+            //similar in all frames of the block if all of its adjacent flags are set
+            for(unsigned int j = 0; j < number_of_words; j++) {
+                flickering[j] &= ~static_pixels[j];
+            }
+        }
+
+        const unsigned int tile = begin / TILE_SIZE;
+        if(tile_masks_epochs[tile] != masks_epoch) {
+            //masks of the tile are not used since the reset, so they are zeroed only before they can be refined
+            for(unsigned int j = 0; j < number_of_masks; j++) {
+                for(unsigned int i = begin; i < end; i++) {
+                    block_masks[j][i] = 0;
                 }
             }
-        });
+            tile_masks_epochs[tile] = masks_epoch;
+        }
+
+        //on GPU refined masks are not applied to the last frame of the block, narrow storage does the same
+        const PixelPlane<PixelT> last_frame = frame_storage == FrameStorage::NARROW ? PixelPlane<PixelT>() : frame_copy;
+        //static pixels are not needed anymore, so their buffer is reused for flags of refined pixels
+        uint64_t *refined = static_pixels.data();
+        std::memset(refined, 0, number_of_words * sizeof(uint64_t));
+        uint64_t *counting = counting_pixels->getWords() + begin_word;
+        //counters of pixels which are not flickering now and were not counted before are already zero, so only runs
+        //of words with flickering or counted pixels are updated
+        for(unsigned int j = 0; j < number_of_words;) {
+            if((flickering[j] | counting[j]) == 0) {
+                j++;
+                continue;
+            }
+            unsigned int run_end = j + 1;
+            while(run_end < number_of_words && (flickering[run_end] | counting[run_end]) != 0) {
+                run_end++;
+            }
+            CPUKernels::updateFlickerCounter(block_frames.data(), block_size, block_masks.data(), flickering.data() + j,
+                                             max_allowed_flicker_duration, begin + j * 64,
+                                             std::min(end, begin + run_end * 64),
+                                             flicker_counter.ptr<unsigned char>(), last_frame, refined + j);
+            j = run_end;
+        }
+        //counters of refined pixels are zeroed, all other flickering pixels keep counting
+        uint64_t refined_words = 0;
+        for(unsigned int j = 0; j < number_of_words; j++) {
+            counting[j] = flickering[j] & ~refined[j];
+            refined_words |= refined[j];
+        }
+        if(refined_words != 0) {
+            refined_tiles[begin / TILE_SIZE] = 1;
+        }
+    }
+
+    if(update.output_frame != nullptr) {
+        CPUKernels::copyFrame(frame_copy, begin, end, update.output_frame->ptr<PixelT>());
     }
-    return frame_copy;
 }
 
 bool FlickerRemoverCPU::similar(int a, int b) const
@@ -199,6 +697,16 @@ void FlickerRemoverCPU::calculateNextExpectedTimestamp(double timestamp)
     expected_timestamp = timestamp + timestamps_delta;
 }
 
+int FlickerRemoverCPU::getFrameType() const
+{
+    return frame_storage == FrameStorage::NARROW ? CV_8UC1 : CV_32S;
+}
+
+int FlickerRemoverCPU::getMaskType() const
+{
+    return frame_storage == FrameStorage::NARROW ? CV_16S : CV_32S;
+}
+
 unsigned int FlickerRemoverCPU::getNumberOfStoredFrames() const
 {
     return frames_block.maxSize();
@@ -206,30 +714,313 @@ unsigned int FlickerRemoverCPU::getNumberOfStoredFrames() const
 
 void FlickerRemoverCPU::reset()
 {
-    clear();
-    frames_block.clear();
-    corresponding_frames_similarity_levels.clear();
-    adjacent_frames_similarity_levels.clear();
-    flicker_counter.setTo(Scalar(0));
+    clearHistory();
+    //masks of tiles without the refined flag are not used, so they are zeroed lazily
+    masks_epoch++;
+    std::fill(refined_tiles.begin(), refined_tiles.end(), 0);
+    actual_mask = number_of_masks;
+    learning_scheduler.reset();
+    load_shedder.reset();
+}
+
+bool FlickerRemoverCPU::setLearningSchedule(const LearningSchedule &schedule, string &error)
+{
+    const unsigned int warm_up_blocks = getWarmUpDuration() / block_size;
+    if(schedule.learning_blocks != 0 && schedule.learning_blocks < warm_up_blocks) {
+        error = "Learning schedule cannot be set. Learning phase must last at least " + to_string(warm_up_blocks) +
+                " blocks to refine masks.";
+        return false;
+    }
+    learning_scheduler.setSchedule(schedule);
+    return true;
+}
+
+const LearningSchedule &FlickerRemoverCPU::getLearningSchedule() const
+{
+    return learning_scheduler.getSchedule();
+}
+
+bool FlickerRemoverCPU::isLearning() const
+{
+    return learning_scheduler.isLearning() && load_shedder.getAction() == OverloadAction::NONE;
+}
+
+bool FlickerRemoverCPU::setOverloadPolicy(const OverloadPolicy &policy, string &error)
+{
+    return load_shedder.setPolicy(policy, error);
+}
+
+const OverloadPolicy &FlickerRemoverCPU::getOverloadPolicy() const
+{
+    return load_shedder.getPolicy();
+}
+
+const OverloadCounters &FlickerRemoverCPU::getOverloadCounters() const
+{
+    return load_shedder.getCounters();
+}
+
+void FlickerRemoverCPU::setInputLag(double lag)
+{
+    load_shedder.setLag(lag);
+}
+
+void FlickerRemoverCPU::clearHistory()
+{
+    returnFramesToFramePool();
+    //both buffers of similarity levels stay full, all their levels become stale
+    stale_corresponding_levels = corresponding_frames_similarity_levels.size();
+    stale_adjacent_levels = adjacent_frames_similarity_levels.size();
+    history_epoch++;
+}
+
+Mat FlickerRemoverCPU::takeFromFramePool()
+{
+    Mat frame = std::move(frame_pool.back());
+    frame_pool.pop_back();
+    return frame;
+}
+
+void FlickerRemoverCPU::returnFramesToFramePool()
+{
+    //the pool has room for all buffers, so moving frames does not allocate memory
+    while(!frames_block.isEmpty()) {
+        frame_pool.push_back(frames_block.pop());
+    }
+}
+
+void FlickerRemoverCPU::clearStaleTileHistory(unsigned int epoch, unsigned int begin, unsigned int end)
+{
+    const unsigned int tile = begin / TILE_SIZE;
+    if(tile_history_epochs[tile] == epoch) {
+        return;
+    }
+    const unsigned int begin_word = begin / 64;
+    const unsigned int end_word = (end + 63) / 64;
+    std::memset(flicker_counter.ptr<unsigned char>() + begin, 0, end - begin);
+    std::memset(counting_pixels->getWords() + begin_word, 0, (end_word - begin_word) * sizeof(uint64_t));
+    if(similarity_counters == SimilarityCounters::BIT_SLICED) {
+        corresponding_frames_similarity_counter->setZero(begin_word, end_word);
+        adjacent_frames_similarity_counter->setZero(begin_word, end_word);
+    } else {
+        std::memset(corresponding_frames_similarity_sum.ptr<unsigned char>() + begin, 0, end - begin);
+        std::memset(adjacent_frames_similarity_sum.ptr<unsigned char>() + begin, 0, end - begin);
+    }
+    tile_history_epochs[tile] = epoch;
+}
+
+bool FlickerRemoverCPU::saveState(const string &path, string &error) const
+{
+    StateWriter writer(path, STATE_KIND, STATE_VERSION);
+    writer.write((int32_t) frame_rows);
+    writer.write((int32_t) frame_cols);
+    writer.write((uint32_t) learning_scale);
+    writer.write((uint32_t) block_size);
+    writer.write(timestamps_delta);
+    writer.write((uint32_t) frame_storage);
+
+    const auto length = (unsigned int) (learning_rows * learning_cols);
+    const bool narrow = frame_storage == FrameStorage::NARROW;
+    writer.write((uint32_t) actual_mask);
+    writer.write(refined_tiles.data(), refined_tiles.size());
+    //buffers which are cleared lazily are written as zeros, tile after tile
+    const vector<int> zeros(TILE_SIZE, 0);
+    const auto number_of_tiles = (unsigned int) refined_tiles.size();
+    for(const auto &mask: masks) {
+        for(unsigned int tile = 0; tile < number_of_tiles; tile++) {
+            const unsigned int begin = tile * TILE_SIZE;
+            const unsigned int end = std::min(length, begin + TILE_SIZE);
+            if(refined_tiles[tile] == 0) {
+                writer.write(zeros.data(), (end - begin) * (narrow ? sizeof(short) : sizeof(int)));
+            } else if(narrow) {
+                writePlane<short>(writer, mask, begin, end);
+            } else {
+                writePlane<int>(writer, mask, begin, end);
+            }
+        }
+    }
+    for(unsigned int tile = 0; tile < number_of_tiles; tile++) {
+        const unsigned int begin = tile * TILE_SIZE;
+        const unsigned int end = std::min(length, begin + TILE_SIZE);
+        const bool stale = tile_history_epochs[tile] != history_epoch;
+        writer.write(stale ? (const void *) zeros.data() : flicker_counter.ptr<unsigned char>() + begin, end - begin);
+    }
+    for(unsigned int tile = 0; tile < number_of_tiles; tile++) {
+        const unsigned int begin_word = tile * TILE_SIZE / 64;
+        const unsigned int end_word = std::min(counting_pixels->getNumberOfWords(), begin_word + TILE_SIZE / 64);
+        const bool stale = tile_history_epochs[tile] != history_epoch;
+        writer.write(stale ? (const void *) zeros.data() : counting_pixels->getWords() + begin_word,
+                     (end_word - begin_word) * sizeof(uint64_t));
+    }
+    writer.write((uint32_t) frames_block.size());
+    for(unsigned int j = 0; j < frames_block.size(); j++) {
+        if(narrow) {
+            writePlane<unsigned char>(writer, frames_block[(int) j], 0, length);
+        } else {
+            writePlane<int>(writer, frames_block[(int) j], 0, length);
+        }
+    }
+    //sums are sums of similarity levels, so they are calculated again when the state is restored
+    for(unsigned int j = 0; j < corresponding_frames_similarity_levels.size(); j++) {
+        const BooleanArray2D &levels = j < stale_corresponding_levels ? *zero_levels :
+                                       *corresponding_frames_similarity_levels[(int) j];
+        writer.write(levels.getWords(), levels.getNumberOfWords() * sizeof(uint64_t));
+    }
+    for(unsigned int j = 0; j < adjacent_frames_similarity_levels.size(); j++) {
+        const BooleanArray2D &levels = j < stale_adjacent_levels ? *zero_levels :
+                                       *adjacent_frames_similarity_levels[(int) j];
+        writer.write(levels.getWords(), levels.getNumberOfWords() * sizeof(uint64_t));
+    }
+    return writer.commit(error);
+}
+
+bool FlickerRemoverCPU::loadState(const string &path, string &error)
+{
+    StateReader reader(path, STATE_KIND, STATE_VERSION);
+    const auto rows = reader.read<int32_t>();
+    const auto cols = reader.read<int32_t>();
+    const auto scale = reader.read<uint32_t>();
+    const auto saved_block_size = reader.read<uint32_t>();
+    const auto saved_timestamps_delta = reader.read<double>();
+    const auto storage = reader.read<uint32_t>();
+    if(!reader.isValid()) {
+        return reader.finish(error);
+    }
+    //parameters are checked first, so the state of this flicker remover is not changed if they do not match
+    if(rows != frame_rows || cols != frame_cols) {
+        error = "State cannot be restored. It was saved for frames of size: " + to_string(cols) + "x" +
+                to_string(rows) + " different than expected: " + to_string(frame_cols) + "x" + to_string(frame_rows) +
+                ".";
+        return false;
+    }
+    if(saved_block_size != block_size || std::abs(saved_timestamps_delta - timestamps_delta) > 1e-9) {
+        error = "State cannot be restored. It was saved for camera with fps: " +
+                to_string(1000.0 / saved_timestamps_delta) + " different than expected: " +
+                to_string(1000.0 / timestamps_delta) + ".";
+        return false;
+    }
+    if(scale != learning_scale || storage != (uint32_t) frame_storage) {
+        error = "State cannot be restored. It was saved with different learning scale or storage of frames.";
+        return false;
+    }
+
+    const auto length = (unsigned int) (learning_rows * learning_cols);
+    const bool narrow = frame_storage == FrameStorage::NARROW;
+    const auto saved_actual_mask = reader.read<uint32_t>();
+    reader.read(refined_tiles.data(), refined_tiles.size());
+    for(auto &mask: masks) {
+        if(narrow) {
+            readPlane<short>(reader, mask, length);
+        } else {
+            readPlane<int>(reader, mask, length);
+        }
+    }
+    reader.readMatrix(flicker_counter);
+    reader.read(counting_pixels->getWords(), counting_pixels->getNumberOfWords() * sizeof(uint64_t));
+    const auto number_of_frames = reader.read<uint32_t>();
+    if(saved_actual_mask > number_of_masks || number_of_frames > block_size) {
+        reset();
+        error = "State cannot be restored. File is corrupted.";
+        return false;
+    }
+    returnFramesToFramePool();
+    for(unsigned int j = 0; j < number_of_frames; j++) {
+        Mat frame = takeFromFramePool();
+        if(frame_layout == FrameLayout::PLANAR && isShared(frame)) {
+            //the caller still holds this frame, so it is not overwritten
+            frame = Mat(learning_rows, learning_cols, getFrameType());
+        }
+        if(narrow) {
+            readPlane<unsigned char>(reader, frame, length);
+        } else {
+            readPlane<int>(reader, frame, length);
+        }
+        frames_block.push(std::move(frame));
+    }
+    for(unsigned int j = 0; j < corresponding_frames_similarity_levels.size(); j++) {
+        BooleanArray2D &levels = *corresponding_frames_similarity_levels[(int) j];
+        reader.read(levels.getWords(), levels.getNumberOfWords() * sizeof(uint64_t));
+    }
+    for(unsigned int j = 0; j < adjacent_frames_similarity_levels.size(); j++) {
+        BooleanArray2D &levels = *adjacent_frames_similarity_levels[(int) j];
+        reader.read(levels.getWords(), levels.getNumberOfWords() * sizeof(uint64_t));
+    }
+    if(!reader.finish(error)) {
+        reset();
+        return false;
+    }
+    calculateSimilaritySums();
+    //all buffers were overwritten, so none of them is cleared lazily anymore
+    stale_corresponding_levels = 0;
+    stale_adjacent_levels = 0;
+    std::fill(tile_history_epochs.begin(), tile_history_epochs.end(), history_epoch);
+    std::fill(tile_masks_epochs.begin(), tile_masks_epochs.end(), masks_epoch);
+    actual_mask = saved_actual_mask;
+    //timestamps of the camera usually start over after a restart, so the first timestamp is accepted
+    expected_timestamp = FIRST_TIMESTAMP;
+    learning_scheduler.reset();
+    load_shedder.reset();
+    return true;
+}
+
+void FlickerRemoverCPU::calculateSimilaritySums()
+{
+    const unsigned int number_of_words = counting_pixels->getNumberOfWords();
+    if(similarity_counters == SimilarityCounters::BIT_SLICED) {
+        const vector<uint64_t> no_flags(number_of_words, 0);
+        corresponding_frames_similarity_counter->setZero();
+        adjacent_frames_similarity_counter->setZero();
+        for(unsigned int j = 0; j < corresponding_frames_similarity_levels.size(); j++) {
+            corresponding_frames_similarity_counter->update(
+                    0, number_of_words, corresponding_frames_similarity_levels[(int) j]->getWords(), no_flags.data());
+        }
+        for(unsigned int j = 0; j < adjacent_frames_similarity_levels.size(); j++) {
+            adjacent_frames_similarity_counter->update(
+                    0, number_of_words, adjacent_frames_similarity_levels[(int) j]->getWords(), no_flags.data());
+        }
+        return;
+    }
+    auto add_levels = [number_of_words](const BooleanArray2D &levels, Mat &sum) {
+        auto *sum_data = sum.ptr<unsigned char>();
+        for(unsigned int j = 0; j < number_of_words; j++) {
+            uint64_t word = levels.getWords()[j];
+            while(word != 0) {
+                sum_data[j * 64 + (unsigned int) __builtin_ctzll(word)]++;
+                word &= word - 1;
+            }
+        }
+    };
     corresponding_frames_similarity_sum.setTo(Scalar(0));
-    masks.clear();
-    masks.reserve(number_of_masks);
-    for(unsigned int j = 0; j < number_of_masks; j++) {
-        masks.emplace_back(frame_rows, frame_cols, CV_32S, Scalar(0));
+    adjacent_frames_similarity_sum.setTo(Scalar(0));
+    for(unsigned int j = 0; j < corresponding_frames_similarity_levels.size(); j++) {
+        add_levels(*corresponding_frames_similarity_levels[(int) j], corresponding_frames_similarity_sum);
     }
-    actual_mask = number_of_masks;
+    for(unsigned int j = 0; j < adjacent_frames_similarity_levels.size(); j++) {
+        add_levels(*adjacent_frames_similarity_levels[(int) j], adjacent_frames_similarity_sum);
+    }
+}
+
+void FlickerRemoverCPU::allocateSimilarityLevels(unsigned int first_plane)
+{
+    const auto rows = (unsigned int) learning_rows;
+    const auto cols = (unsigned int) learning_cols;
+    unsigned int plane = first_plane;
     for(unsigned int j = 0; j < block_size; j++) {
-        corresponding_frames_similarity_levels.push(
-                new BooleanArray2D((unsigned int) frame_rows, (unsigned int) frame_cols));
+        corresponding_frames_similarity_levels.push(new BooleanArray2D(rows, cols, arena.getPlane<uint64_t>(plane++)));
     }
     for(unsigned int j = 0; j < block_size - 1; j++) {
-        adjacent_frames_similarity_levels.push(
-                new BooleanArray2D((unsigned int) frame_rows, (unsigned int) frame_cols));
+        adjacent_frames_similarity_levels.push(new BooleanArray2D(rows, cols, arena.getPlane<uint64_t>(plane++)));
     }
+    spare_corresponding_levels = new BooleanArray2D(rows, cols, arena.getPlane<uint64_t>(plane++));
+    spare_adjacent_levels = new BooleanArray2D(rows, cols, arena.getPlane<uint64_t>(plane));
 }
 
 void FlickerRemoverCPU::clear()
 {
+    delete spare_corresponding_levels;
+    spare_corresponding_levels = nullptr;
+    delete spare_adjacent_levels;
+    spare_adjacent_levels = nullptr;
     auto to_delete_1 = corresponding_frames_similarity_levels.pop();
     while(to_delete_1 != nullptr) {
         delete to_delete_1;
@@ -250,16 +1041,24 @@ bool FlickerRemoverCPU::getMaskOfStaticPixelsOfLastPairOfFrames(Mat &mask, strin
                 "Flicker remover processed less than 2 frames and cannot generate a requested mask.";
         return false;
     } else {
-        auto source = frames_block.last();
-        auto source_prev = frames_block[-2];
-        mask = Mat::zeros(source->rows, source->cols, CV_8UC1);
+        const Mat &source = frames_block.last();
+        const Mat &source_prev = frames_block[-2];
+        mask = Mat::zeros(learning_rows, learning_cols, CV_8UC1);
+        auto mask_data = mask.ptr<unsigned char>();
 //        int y = 0;
-        for(unsigned int row = 0; row < source->rows; ++row) {
-            for(unsigned int col = 0; col < source->cols; ++col) {
-                if(similar(source->at<int>(row, col), source_prev->at<int>(row, col))) {
-                    mask.at<unsigned char>(row, col) = 1;
-//                    y++;
-                }
+        //historical frames may be interleaved, so they are accessed with linear indexes
+        for(unsigned int i = 0; i < (unsigned int) (learning_rows * learning_cols); ++i) {
+            bool pixels_are_similar;
+            if(frame_storage == FrameStorage::NARROW) {
+                pixels_are_similar = similar(pixelPlane<const unsigned char>(source)[i],
+                                             pixelPlane<const unsigned char>(source_prev)[i]);
+            } else {
+                pixels_are_similar = similar(pixelPlane<const int>(source)[i],
+                                             pixelPlane<const int>(source_prev)[i]);
+            }
+            if(pixels_are_similar) {
+                mask_data[i] = 1;
+//                y++;
             }
         }
 
@@ -275,6 +1074,11 @@ bool FlickerRemoverCPU::getMaskOfStaticPixelsOfLastPairOfFrames(Mat &mask, strin
 
 //        std::cout << x << " " << y << " " << (x != y ? "X" : ".") << std::endl;
 
+        if(learning_scale > 1) {
+            //every flag describes one block of pixels of the frame
+            Mat learning_mask = mask;
+            resize(learning_mask, mask, Size(frame_cols, frame_rows), 0, 0, INTER_NEAREST);
+        }
         return true;
     }
 
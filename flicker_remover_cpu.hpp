@@ -10,11 +10,70 @@
 #include <string>
 #include "circular_buffer.hpp"
 #include "boolean_array_2_d.hpp"
+#include "bit_sliced_counter.hpp"
+#include "cpu_kernels.hpp"
+#include "thread_pool.hpp"
+#include "learning_scheduler.hpp"
+#include "load_shedder.hpp"
+#include "memory_arena.hpp"
 
 using cv::Mat;
 using std::vector;
 using std::string;
 
+/**
+ * @brief Types used by FlickerRemoverCPU to store copies of historical frames and masks.
+ */
+enum class FrameStorage {
+    /**
+     * @brief Frames and masks are stored as int values and results of applying masks are not saturated.
+     */
+    WIDE,
+
+    /**
+     * @brief Frames are stored as unsigned char values and masks as short values. Masks are applied with saturating
+     * arithmetic and masks are not applied to the last frame of the block when they are refined, exactly like in
+     * FlickerRemover running on GPU. It needs 4 times less memory for the history than <b>WIDE</b> storage.
+     */
+    NARROW
+};
+
+/**
+ * @brief Representations used by FlickerRemoverCPU to store per-pixel sums of similarity flags.
+ */
+enum class SimilarityCounters {
+    /**
+     * @brief Every sum is stored as one unsigned char value of the CV_8U matrix.
+     */
+    BYTES,
+
+    /**
+     * @brief Sums are stored as bit planes of BitSlicedCounter, so counters of 64 pixels are updated and compared with
+     * the threshold with a few word operations. It needs less memory than <b>BYTES</b> for blocks shorter than 256
+     * frames.
+     */
+    BIT_SLICED
+};
+
+/**
+ * @brief Layouts used by FlickerRemoverCPU to store historical frames and masks.
+ */
+enum class FrameLayout {
+    /**
+     * @brief Every historical frame and every mask is a separate continuous matrix.
+     */
+    PLANAR,
+
+    /**
+     * @brief All historical frames are stored in one matrix in which every row is one lane group of 16 consecutive
+     * pixels (see PixelPlane) and columns hold samples of these pixels from consecutive slots of the ring of frames.
+     * All masks are stored the same way in another matrix. Samples of one pixel from all frames of the block and all
+     * its masks are in a few adjacent cache lines, so comparisons with older frames and refinement of masks stream
+     * through memory linearly. Returned frames are copied from the history to separate continuous buffers.
+     */
+    INTERLEAVED
+};
+
 /**
  * @brief Class implementing simple algorithm to remove flickering in the consecutive frames captured by camera.
  * Flickering is caused by changes in the current. The artificial light usually is turned on and off 50 times per second.
@@ -28,6 +87,13 @@ protected:
      */
     static const double FIRST_TIMESTAMP;
 
+    /**
+     * @brief Number of pixels in one tile. Frames are processed tile after tile, and all steps of the algorithm are run
+     * on one tile before the next one is processed, so history frames, masks and sums of the tile are read from cache.
+     * It is a multiple of 64, so every tile starts at a word boundary of packed similarity flags.
+     */
+    static const unsigned int TILE_SIZE;
+
     /**
      * @brief Expected, usual difference between timestamps of the consecutive frames. Calculated from camera's fps.
      * This value is stored in milliseconds.
@@ -65,6 +131,14 @@ protected:
      */
     unsigned int actual_mask;
 
+    /**
+     * @brief Memory of all buffers which never leave this class: masks, similarity levels, sums, counters and
+     * historical frames with <b>FrameLayout::INTERLEAVED</b> or with <b>learning_scale</b> bigger than 1. Historical
+     * frames which are returned to the caller are allocated separately, so they can outlive this object. Tiles of the
+     * arena are zeroed by threads processing them, so they are local to these threads on NUMA machines.
+     */
+    MemoryArena arena;
+
     /**
      * @brief Calculated masks which are used to remove flickering. They are applied to the consecutive frames.
      * Every time next mask is applied. When last mask is applied, then we make a brake for one frame, and then we
@@ -73,11 +147,46 @@ protected:
     vector<Mat> masks;
 
     /**
-     * @brief Circular buffer of pointers to copies of historical frames. Number of frames is double the number of
+     * @brief Flags of tiles in which masks of at least one pixel were refined since the last reset. Masks of all pixels
+     * of other tiles are zero, so in these tiles frames are only converted instead of subtracting masks. Refinement
+     * changes all masks of the pixel, so the flags are shared by all masks.
+     */
+    vector<unsigned char> refined_tiles;
+
+    /**
+     * @brief Circular buffer of copies of historical frames. Number of frames is double the number of
      * frames per block. Number of frames per block is equal to number of masks plus 1.
-     * These frames are used to detect flickering patterns for every pixel.
+     * These frames are used to detect flickering patterns for every pixel. Frames are stored by value, every buffer
+     * of a frame is referenced by exactly one header inside this class.
+     */
+    CircularBuffer<Mat> frames_block;
+
+    /**
+     * @brief Preallocated buffers of historical frames which are not stored in <b>frames_block</b> nor used as
+     * <b>spare_frame</b>. Buffers are recycled, so in the steady state no memory is allocated for frames.
      */
-    CircularBuffer<Mat *> frames_block;
+    vector<Mat> frame_pool;
+
+    /**
+     * @brief Buffer which is not stored in <b>frames_block</b> and which will be used for the copy of the next
+     * processed frame. With the frames of the block it makes one buffer more than frames in the block, so the new
+     * frame can be written while the oldest one is still needed.
+     */
+    Mat spare_frame;
+
+    /**
+     * @brief With <b>FrameLayout::INTERLEAVED</b> storage of all historical frames, which are views of its column
+     * ranges kept in <b>frames_block</b>, <b>frame_pool</b> and <b>spare_frame</b>, and storage of all masks, which
+     * are views kept in <b>masks</b>. Empty otherwise.
+     */
+    Mat interleaved_frames;
+    Mat interleaved_masks;
+
+    /**
+     * @brief Continuous buffer for the returned frame with <b>FrameLayout::INTERLEAVED</b> or with
+     * <b>learning_scale</b> bigger than 1. It is recycled unless the caller still holds it.
+     */
+    Mat output_frame;
 
     /**
      * @brief Circular buffer of pointers to special arrays with infos about similarities of corresponding frames from
@@ -95,6 +204,14 @@ protected:
      */
     CircularBuffer<BooleanArray2D *> adjacent_frames_similarity_levels;
 
+    /**
+     * @brief Spare similarity levels used for the next frame. Levels removed from
+     * <b>corresponding_frames_similarity_levels</b> and <b>adjacent_frames_similarity_levels</b> are recycled as the
+     * next spare ones, so in the steady state no memory is allocated for similarity levels.
+     */
+    BooleanArray2D *spare_corresponding_levels;
+    BooleanArray2D *spare_adjacent_levels;
+
     /**
      * @brief Special array with infos about levels of similarities of different blocks. The array is the sum of values
      * from all <b>corresponding_frames_similarity_levels</b>. It is used to speed up processing.
@@ -107,12 +224,67 @@ protected:
      */
     Mat adjacent_frames_similarity_sum;
 
+    /**
+     * @brief Bit-sliced versions of <b>corresponding_frames_similarity_sum</b> and
+     * <b>adjacent_frames_similarity_sum</b> used instead of them with <b>SimilarityCounters::BIT_SLICED</b>, nullptr
+     * otherwise.
+     */
+    BitSlicedCounter *corresponding_frames_similarity_counter;
+    BitSlicedCounter *adjacent_frames_similarity_counter;
+
     /**
      * @brief Internal matrix storing counts of last flickers for each pixel. Every similar block for given pixel is
      * counted as 1.
      */
     Mat flicker_counter;
 
+    /**
+     * @brief Flags of pixels which <b>flicker_counter</b> may be non-zero: pixels which were flickering at the end of
+     * the last block and which masks were not refined then. At the end of the block only words of pixels which are
+     * flickering now or have their flags set here are updated, because counters of all other pixels are already zero.
+     * Flickering pixels are usually a small part of the frame, so whole tiles are often skipped.
+     */
+    BooleanArray2D *counting_pixels;
+
+    /**
+     * @brief Similarity levels with all flags cleared, used in place of stale levels removed from similarity buffers.
+     */
+    BooleanArray2D *zero_levels;
+
+    /**
+     * @brief Numbers of the oldest levels in <b>corresponding_frames_similarity_levels</b> and
+     * <b>adjacent_frames_similarity_levels</b> which were stored before the history was cleared. They are not zeroed,
+     * they are treated as zero when they are removed from buffers and then overwritten as spare levels.
+     */
+    unsigned int stale_corresponding_levels;
+    unsigned int stale_adjacent_levels;
+
+    /**
+     * @brief Epoch of the history, incremented when the history is cleared. Sums of similarity flags, flicker counters
+     * and flags of counting pixels of the tile are zeroed when the tile is processed for the first time in the new
+     * epoch, so clearing the history does not touch buffers of the whole frame.
+     */
+    unsigned int history_epoch;
+
+    /**
+     * @brief Epoch of masks, incremented by <b>reset()</b>. Masks of the tile are zeroed at the first end of the block
+     * in the new epoch, before they can be refined. Until then the flag of the tile in <b>refined_tiles</b> is not set,
+     * so its masks are not used.
+     */
+    unsigned int masks_epoch;
+
+    /**
+     * @brief Epochs in which the history and masks of every tile were zeroed for the last time.
+     */
+    vector<unsigned int> tile_history_epochs;
+    vector<unsigned int> tile_masks_epochs;
+
+    /**
+     * @brief Minimum value of <b>corresponding_frames_similarity_sum</b> for which pixel is treated as a candidate for
+     * flickering. It is the smallest integer bigger than 0.7 * block_size.
+     */
+    unsigned int min_similar_blocks;
+
     /**
      * @brief Flickering threshold. When we compare 2 values of the same pixel from 2 consecutive frames, this is the
      * threshold that is used to distinguish flickering pixels from not flickering ones.
@@ -137,6 +309,26 @@ protected:
      */
     const int frame_cols;
 
+    /**
+     * @brief Factor by which frames are downsampled before masks are learnt. Flickering of lamps is spatially smooth,
+     * so with <b>learning_scale</b> bigger than 1 historical frames, similarity levels, flicker counters and masks
+     * describe blocks of <b>learning_scale</b> x <b>learning_scale</b> pixels, and every value of the mask is applied
+     * to the whole block of pixels of the frame.
+     */
+    const unsigned int learning_scale;
+
+    /**
+     * @brief Height and width of frames from which masks are learnt. They are equal to <b>frame_rows</b> and
+     * <b>frame_cols</b> divided by <b>learning_scale</b>.
+     */
+    const int learning_rows;
+    const int learning_cols;
+
+    /**
+     * @brief Downsampled copy of the processed frame when <b>learning_scale</b> is bigger than 1, empty otherwise.
+     */
+    Mat learning_frame;
+
     /**
      * @brief Expected value of the timestamp of the next frame to be processed. It is calculated based on camera's fps
      * and last timestamp. It may be a value in milliseconds or -1 (FIRST_TIMESTAMP) to indicate that we accept any
@@ -144,6 +336,124 @@ protected:
      */
     double expected_timestamp;
 
+    /**
+     * @brief Types used to store copies of historical frames and masks.
+     */
+    const FrameStorage frame_storage;
+
+    /**
+     * @brief Representation of sums of similarity flags.
+     */
+    const SimilarityCounters similarity_counters;
+
+    /**
+     * @brief Layout of historical frames and masks.
+     */
+    const FrameLayout frame_layout;
+
+    /**
+     * @brief Pool of threads processing tiles of frames or nullptr if OpenCV's parallel backend is used. It is not
+     * owned by this object and may be shared with other objects.
+     */
+    ThreadPool *thread_pool;
+
+    /**
+     * @brief Decides for every frame if masks are learnt or only applied.
+     */
+    LearningScheduler learning_scheduler;
+
+    /**
+     * @brief Decides for every frame if it is processed normally, only has the mask applied or is dropped when frames
+     * arrive faster than they are processed.
+     */
+    LoadShedder load_shedder;
+
+    /**
+     * @brief Description of all buffers used to process one frame. All buffers are rotated before processing, so the
+     * frame can be then processed tile by tile with one pass of all steps of the algorithm.
+     */
+    struct FrameUpdate {
+        /**
+         * @brief Source frame.
+         */
+        const Mat *frame;
+
+        /**
+         * @brief Mask applied to the source frame or nullptr for "ground level" frames.
+         */
+        const Mat *mask;
+
+        /**
+         * @brief Frame with removed flickering stored as the newest historical frame. It is also returned unless
+         * <b>output_frame</b> is given.
+         */
+        Mat *frame_copy;
+
+        /**
+         * @brief Continuous buffer to which <b>frame_copy</b> is copied to be returned, or nullptr if
+         * <b>frame_copy</b> is returned.
+         */
+        Mat *output_frame;
+
+        /**
+         * @brief Previous frame or nullptr if there is no previous frame.
+         */
+        const Mat *last_frame;
+
+        /**
+         * @brief Corresponding frame from the previous block or nullptr if there is no such frame.
+         */
+        const Mat *prev_frame;
+
+        /**
+         * @brief Similarity flags of adjacent frames removed from <b>adjacent_frames_similarity_sum</b> and new flags
+         * added to it. Both are nullptr when <b>last_frame</b> is nullptr.
+         */
+        const BooleanArray2D *old_adjacent_levels;
+        BooleanArray2D *new_adjacent_levels;
+
+        /**
+         * @brief Similarity flags of corresponding frames removed from <b>corresponding_frames_similarity_sum</b> and
+         * new flags added to it. Both are nullptr when <b>prev_frame</b> is nullptr.
+         */
+        const BooleanArray2D *old_corresponding_levels;
+        BooleanArray2D *new_corresponding_levels;
+
+        /**
+         * @brief True if the frame is the last frame of the full block and flicker counters and masks are updated.
+         */
+        bool block_end;
+
+        /**
+         * @brief Frames of the full block, oldest first, when <b>block_end</b> is true.
+         */
+        const Mat *block_frames;
+
+        /**
+         * @brief Value of <b>history_epoch</b> when the frame was prepared. Tiles with older epochs are cleared before
+         * the frame is processed, so the history may be cleared between frames of one batch.
+         */
+        unsigned int history_epoch;
+    };
+
+    /**
+     * @brief Headers of buffers used by one FrameUpdate. They are views which do not count references of buffers, so
+     * they do not hide frames held by the caller, and they keep pointing to the same pixels while buffers are recycled
+     * by next frames of a batch.
+     */
+    struct FrameViews {
+        Mat frame_copy;
+        Mat output_frame;
+        Mat last_frame;
+        Mat prev_frame;
+        vector<Mat> block_frames;
+    };
+
+    /**
+     * @brief Views used by <b>removeFlickering()</b>.
+     */
+    FrameViews frame_views;
+
     /**
      * @brief Tests if 2 values are close enough to each other. It is used to compare values of the same pixel from 2
      * different frames. It uses flickering_threshold.
@@ -167,11 +477,113 @@ protected:
     void calculateNextExpectedTimestamp(double timestamp);
 
     /**
-     * @brief Removes allocated earlier data in corresponding_frames_similarity_levels and
-     * adjacent_frames_similarity_levels.
+     * @brief Returns OpenCV type of stored historical frames for the selected <b>frame_storage</b>.
+     */
+    [[nodiscard]] int getFrameType() const;
+
+    /**
+     * @brief Returns OpenCV type of masks for the selected <b>frame_storage</b>.
+     */
+    [[nodiscard]] int getMaskType() const;
+
+    /**
+     * @brief Checks the frame and its timestamp, advances the phase of masks, schedules of learning and the overload
+     * policy, and rotates historical frames and similarity levels, so the frame can be then processed tile by tile.
+     * Pixels are not touched.
+     * @param frame Frame from which flickering will be removed.
+     * @param timestamp Timestamp of the frame.
+     * @param update Returned description of buffers used to process the frame.
+     * @param views Returned views referenced by <b>update</b>.
+     * @param frame_without_flickering Returned frame to which the result will be written, or an empty matrix if the
+     * frame is dropped.
+     * @param dropped Returned true if the frame is dropped by the overload policy and must not be processed.
+     * @param error Returned description of the problem if an error occurs.
+     * @return True if the frame was prepared or dropped, false in case of an error.
+     */
+    bool prepareFrame(const Mat &frame, double timestamp, FrameUpdate &update, FrameViews &views,
+                      Mat &frame_without_flickering, bool &dropped, string &error);
+
+    /**
+     * @brief Runs all steps of the algorithm on whole frames. Tiles are distributed between threads of
+     * <b>thread_pool</b> or of OpenCV's parallel backend, and every tile passes through all frames in their order
+     * before the next tile is processed, so state of the tile stays in cache. All frames are processed in one
+     * parallel loop with a single barrier at its end.
+     * @param updates Descriptions of buffers used to process frames, in the order of frames.
+     * @param number_of_updates Number of frames.
+     */
+    void updateFrames(const FrameUpdate *updates, unsigned int number_of_updates);
+
+    /**
+     * @brief Applies the mask learnt at reduced resolution to the full resolution frame and stores the result in
+     * <b>output_frame</b>. Rows are distributed between threads like tiles in <b>updateFrames()</b>.
+     * @param frame Source frame.
+     * @param mask Mask applied to the frame or nullptr for "ground level" frames.
+     */
+    void applyUpsampledMask(const Mat &frame, const Mat *mask);
+
+    /**
+     * @brief Applies the mask learnt at reduced resolution to rows from range [first_row, end_row) of the frame.
+     * @tparam PixelT Type of pixels of stored historical frames.
+     * @tparam MaskT Type of values of masks.
+     */
+    template<typename PixelT, typename MaskT>
+    void applyUpsampledMaskToRows(const Mat &frame, const Mat *mask, unsigned int first_row, unsigned int end_row);
+
+    /**
+     * @brief Runs all steps of the algorithm on pixels with linear indexes from range [begin, end).
+     * @tparam PixelT Type of pixels of stored historical frames.
+     * @tparam MaskT Type of values of masks.
+     * @param update Description of buffers used to process the frame.
+     * @param begin First processed linear index. It must be a multiple of 64.
+     * @param end Linear index after the last processed one.
+     */
+    template<typename PixelT, typename MaskT>
+    void updateTile(const FrameUpdate &update, unsigned int begin, unsigned int end);
+
+    /**
+     * @brief Creates zeroed similarity levels for corresponding_frames_similarity_levels,
+     * adjacent_frames_similarity_levels and spare levels in consecutive planes of the arena.
+     * @param first_plane Plane of the arena of the first level.
+     */
+    void allocateSimilarityLevels(unsigned int first_plane);
+
+    /**
+     * @brief Removes allocated earlier data in corresponding_frames_similarity_levels,
+     * adjacent_frames_similarity_levels and spare levels.
      */
     void clear();
 
+    /**
+     * @brief Forgets historical frames, similarity levels and flicker counters, but keeps masks, so learning can start
+     * over while masks are still applied. Buffers are not touched, only epochs and numbers of stale levels change.
+     */
+    void clearHistory();
+
+    /**
+     * @brief Takes an unused buffer of a historical frame from <b>frame_pool</b>. The pool must not be empty.
+     */
+    Mat takeFromFramePool();
+
+    /**
+     * @brief Moves all frames from <b>frames_block</b> back to <b>frame_pool</b>, so the block is empty.
+     */
+    void returnFramesToFramePool();
+
+    /**
+     * @brief Zeroes sums of similarity flags (or bit-sliced counters), flicker counters and flags of counting pixels
+     * of the range of pixels if the history of its tile was cleared. See <b>history_epoch</b>.
+     * @param epoch History epoch of the processed frame.
+     * @param begin Linear index of the first pixel of the tile.
+     * @param end Linear index after the last pixel of the tile.
+     */
+    void clearStaleTileHistory(unsigned int epoch, unsigned int begin, unsigned int end);
+
+    /**
+     * @brief Calculates sums of similarity flags (or bit-sliced counters) from similarity levels, for example after
+     * levels are restored.
+     */
+    void calculateSimilaritySums();
+
 public:
     /**
      * @brief Constructor. Based on fps of the camera calculates number of masks.
@@ -185,9 +597,24 @@ public:
      * before being removed.
      * @param frame_rows Height of the frames that can be processed by this flickering remover.
      * @param frame_cols Width of the frames that can be processed by this flickering remover.
+     * @param frame_storage Types used to store copies of historical frames and masks. Frames returned from
+     * <b>removeFlickering()</b> are of type CV_32S for <b>FrameStorage::WIDE</b> and CV_8UC1 for
+     * <b>FrameStorage::NARROW</b>.
+     * @param similarity_counters Representation of sums of similarity flags. It does not change results.
+     * @param frame_layout Layout of historical frames and masks. It does not change results.
+     * @param thread_pool Pool of threads processing frames or nullptr if OpenCV's parallel backend should be used. The
+     * pool may be shared by many flicker removers, so streams from many cameras do not oversubscribe the machine. It
+     * must outlive this object.
+     * @param learning_scale Factor equal to 1, 2 or 4 by which frames are downsampled with a box filter before masks are
+     * learnt. Frame sizes must be its multiples. Learning cost and memory of the state drop by its square, and masks
+     * are applied to blocks of pixels of full resolution frames.
+     * @param memory_pages Pages backing the memory of the state. See <b>MemoryPages</b>.
      */
     FlickerRemoverCPU(unsigned int camera_fps, int flickering_threshold, int max_allowed_flicker_duration,
-                      int frame_rows, int frame_cols);
+                      int frame_rows, int frame_cols, FrameStorage frame_storage = FrameStorage::WIDE,
+                      SimilarityCounters similarity_counters = SimilarityCounters::BYTES,
+                      FrameLayout frame_layout = FrameLayout::PLANAR, ThreadPool *thread_pool = nullptr,
+                      unsigned int learning_scale = 1, MemoryPages memory_pages = MemoryPages::NORMAL);
 
     /**
      * @brief Default destructor.
@@ -195,18 +622,43 @@ public:
     virtual ~FlickerRemoverCPU();
 
     /**
-     * @brief Creates and returns pointer to the new frame which is constructed from passed in parameter frame
-     * by applying one of the masks calculated earlier. It also refines mask used to remove flickering.
-     * @param frame Frame from which copy is made and from this copy flickering is removed. Pointer to the copy is
-     * returned.
+     * @brief Makes a copy of the passed in parameter frame and removes flickering from it by applying one of the masks
+     * calculated earlier. It also refines mask used to remove flickering.
+     *
+     * The copy is stored in one of the buffers of the internal pool. Returned frame shares this buffer (Mat is
+     * reference counted), so it stays valid for as long as the caller keeps it. The buffer is recycled after
+     * <b>getNumberOfStoredFrames()</b> next calls (with <b>FrameLayout::INTERLEAVED</b> returned frames are separate
+     * copies recycled in the next call). If the caller still holds the returned frame then, a new buffer is allocated
+     * in its place, so frames held by the caller are never overwritten. Frames should be released earlier to avoid
+     * allocations.
+     * @param frame Frame from which copy is made and from this copy flickering is removed.
      * @param timestamp Timestamp of the frame used to control if we remove flickering from consecutive frames.
      * The algorithm of this class uses set of masks that have to be applied in accurate order. If we dropped one or
      * more frames we have to detect such situations and adapt the order of applying masks. We use timestamps to detect
      * frame drops.
+     * @param frame_without_flickering Returned copy of the frame with removed flickering.
+     * @param error Returned description of the problem if an error occurs.
+     * @return True if flickering was removed or the frame was dropped by the overload policy (then the returned frame
+     * is empty), false in case of an error.
+     */
+    bool removeFlickering(const Mat &frame, double timestamp, Mat &frame_without_flickering, string &error);
+
+    /**
+     * @brief Removes flickering from consecutive frames with the same results as calling <b>removeFlickering()</b>
+     * for every frame, but processes them tile by tile: every tile of the state passes through all frames before the
+     * next tile is loaded, so history, masks and sums of the tile stay in cache. It is meant for catching up after a
+     * stall or for recorded footage, best with batches of at least one block of frames
+     * (<b>getNumberOfStoredFrames()</b>). With learning at reduced resolution frames are processed one by one.
+     * @param frames Frames from which flickering will be removed, in the order of their timestamps.
+     * @param timestamps Timestamps of the frames, see <b>removeFlickering()</b>.
+     * @param frames_without_flickering Returned frames with removed flickering, one per frame. Frames dropped by the
+     * overload policy are empty.
      * @param error Returned description of the problem if an error occurs.
-     * @return Pointer to the newly allocated frame or nullptr in case of an error.
+     * @return True if all frames were processed, false in case of an error. Frames before the one causing the error
+     * are processed anyway, the returned frames of the following ones are empty.
      */
-    Mat *removeFlickering(const Mat &frame, double timestamp, string &error);
+    bool processBatch(const vector<Mat> &frames, const vector<double> &timestamps,
+                      vector<Mat> &frames_without_flickering, string &error);
 
     /**
      * @brief Getter for calculated number of elements stored in blocks buffer.
@@ -216,10 +668,54 @@ public:
     [[nodiscard]] unsigned int getNumberOfStoredFrames() const;
 
     /**
-     * @brief Resets internal state, so the processing can start over.
+     * @brief Resets internal state, so the processing can start over. Learning of masks is resumed, but the schedule
+     * of learning and the overload policy with its counters are kept. No memory is allocated and buffers are zeroed
+     * lazily, tile after tile, while next frames are processed, so reset itself takes nearly no time.
      */
     void reset();
 
+    /**
+     * @brief Sets the schedule of learning of masks. While learning is frozen, <b>removeFlickering()</b> only applies
+     * masks to frames, so similarity levels, flicker counters and masks are not updated. When learning is resumed,
+     * history of frames is cleared and it is gathered again. By default learning is never frozen.
+     * @param schedule New schedule.
+     * @param error Returned description of the problem if an error occurs.
+     * @return True if the schedule was set, false if its learning phases are too short to refine any mask.
+     */
+    bool setLearningSchedule(const LearningSchedule &schedule, string &error);
+
+    [[nodiscard]] const LearningSchedule &getLearningSchedule() const;
+
+    /**
+     * @brief True if masks were learnt with the last processed frame, false if learning was frozen or suspended by the
+     * overload policy.
+     */
+    [[nodiscard]] bool isLearning() const;
+
+    /**
+     * @brief Sets the policy for frames arriving faster than they are processed. Lags are reported with
+     * <b>setInputLag()</b>. Dropped frames advance the mask phase like processed ones, and when learning is resumed
+     * history of frames is cleared, so masks are refined only with consecutive frames. By default the policy is
+     * disabled.
+     * @param policy New policy.
+     * @param error Returned description of the problem if an error occurs.
+     * @return True if the policy was set, false if its thresholds are invalid.
+     */
+    bool setOverloadPolicy(const OverloadPolicy &policy, string &error);
+
+    [[nodiscard]] const OverloadPolicy &getOverloadPolicy() const;
+
+    /**
+     * @brief Returns numbers of times the overload policy fired since construction.
+     */
+    [[nodiscard]] const OverloadCounters &getOverloadCounters() const;
+
+    /**
+     * @brief Reports the lag of the input, used by the overload policy for the next frames.
+     * @param lag Lag in milliseconds, for example the age of the next frame waiting in the input queue.
+     */
+    void setInputLag(double lag);
+
     /**
      * @brief Returns a matrix with pixels set to 1 where there was no movement detected and 0 for pixels that were
      * detected as movement.
@@ -229,6 +725,29 @@ public:
      */
     bool getMaskOfStaticPixelsOfLastPairOfFrames(Mat &mask, string &error) const;
 
+    /**
+     * @brief Saves the learnt state to the binary file: masks, flicker counters, historical frames, similarity levels
+     * and the phase of masks. Sums of similarity flags are not saved, because they are calculated from similarity
+     * levels. The file is replaced only when the whole state is written.
+     * @param path Path of the file.
+     * @param error Returned description of the problem if an error occurs.
+     * @return True if the state was saved, false otherwise.
+     */
+    bool saveState(const string &path, string &error) const;
+
+    /**
+     * @brief Restores the state saved by <b>saveState()</b>, so after a restart flickering is removed from the first
+     * block instead of after <b>getWarmUpDuration()</b> frames. It should be called right after construction. The
+     * state must be saved by the flicker remover for the camera with the same fps, the same size of frames, learning
+     * scale and storage of frames (layout and representation of sums may differ). The next frame may have any
+     * timestamp, the schedule of learning starts over and the overload policy resumes normal processing.
+     * @param path Path of the file.
+     * @param error Returned description of the problem if an error occurs.
+     * @return True if the state was restored. False if the state does not match this flicker remover, which is not
+     * changed then, or if the file is corrupted, in which case the flicker remover is reset.
+     */
+    bool loadState(const string &path, string &error);
+
     /**
      * @brief Calculates number of frames after which flicker remover starts to remove flickering from frames.
      * @return Number of first frames processed without removing flickering.
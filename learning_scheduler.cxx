@@ -0,0 +1,74 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#include "learning_scheduler.hpp"
+#include <cmath>
+
+LearningScheduler::LearningScheduler(unsigned int block_size)
+        : block_size(block_size), schedule{0, 0, 0}, learning(true), blocks_in_phase(0)
+{
+}
+
+void LearningScheduler::setBlockSize(unsigned int new_block_size)
+{
+    block_size = new_block_size;
+    reset();
+}
+
+void LearningScheduler::setSchedule(const LearningSchedule &new_schedule)
+{
+    schedule = new_schedule;
+}
+
+const LearningSchedule &LearningScheduler::getSchedule() const
+{
+    return schedule;
+}
+
+bool LearningScheduler::isLearning() const
+{
+    return learning;
+}
+
+bool LearningScheduler::nextFrame(unsigned int position, const std::function<double()> &brightness)
+{
+    if(position == 0) {
+        blocks_in_phase++;
+        if(learning) {
+            if(schedule.learning_blocks != 0 && blocks_in_phase > schedule.learning_blocks) {
+                freeze();
+                blocks_in_phase = 1;
+            }
+        } else if(schedule.learning_blocks == 0 ||
+                  (schedule.frozen_blocks != 0 && blocks_in_phase > schedule.frozen_blocks)) {
+            learning = true;
+            blocks_in_phase = 1;
+            return true;
+        }
+    }
+    if(!learning && schedule.change_threshold > 0 && position < block_size) {
+        double &reference = reference_brightness[position];
+        if(reference < 0) {
+            reference = brightness();
+        } else if(std::abs(brightness() - reference) > schedule.change_threshold) {
+            //the block is not complete, so it is not counted as a learning block
+            learning = true;
+            blocks_in_phase = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+void LearningScheduler::reset()
+{
+    learning = true;
+    blocks_in_phase = 0;
+}
+
+void LearningScheduler::freeze()
+{
+    learning = false;
+    reference_brightness.assign(block_size, -1);
+}
@@ -0,0 +1,117 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#ifndef LEARNING_SCHEDULER_HPP
+#define LEARNING_SCHEDULER_HPP
+
+#include <functional>
+#include <vector>
+
+/**
+ * @brief Schedule of learning of masks. When learning is frozen, flicker removers only apply masks to frames, so
+ * similarity levels, flicker counters and masks are not updated.
+ */
+struct LearningSchedule {
+    /**
+     * @brief Number of blocks for which masks are learnt before learning is frozen, or 0 if learning is never frozen.
+     * History of frames is not updated while learning is frozen, so every learning phase starts from the empty history
+     * and it should be longer than the warm-up duration of the flicker remover to refine any masks.
+     */
+    unsigned int learning_blocks;
+
+    /**
+     * @brief Number of blocks for which learning is frozen before it is resumed, or 0 if it is resumed only by the
+     * change detector. For a time budget it is the budget multiplied by the camera fps and divided by the block size.
+     */
+    unsigned int frozen_blocks;
+
+    /**
+     * @brief Change of the mean brightness of the frame in relation to the frame with the same position in the block
+     * from the first frozen block, above which learning is resumed, or 0 if the change detector is disabled. Frames
+     * with the same position in the block have the same lightning conditions, so flickering itself does not trigger
+     * the detector.
+     */
+    double change_threshold;
+};
+
+/**
+ * @brief Decides for every frame if flicker remover learns masks or only applies them, according to
+ * <b>LearningSchedule</b>. Phases change only at block boundaries, except for the change detector, which resumes
+ * learning immediately.
+ */
+class LearningScheduler {
+protected:
+    /**
+     * @brief Number of frames in one block.
+     */
+    unsigned int block_size;
+
+    /**
+     * @brief Current schedule.
+     */
+    LearningSchedule schedule;
+
+    /**
+     * @brief True if masks are learnt, false if learning is frozen.
+     */
+    bool learning;
+
+    /**
+     * @brief Number of started blocks of the current phase.
+     */
+    unsigned int blocks_in_phase;
+
+    /**
+     * @brief Mean brightness of frames with consecutive positions in the block from the first frozen block, or
+     * negative values for positions not seen yet.
+     */
+    std::vector<double> reference_brightness;
+
+    /**
+     * @brief Freezes learning and forgets reference brightness.
+     */
+    void freeze();
+
+public:
+    /**
+     * @brief Constructor. Learning is never frozen until the schedule is set.
+     * @param block_size Number of frames in one block.
+     */
+    explicit LearningScheduler(unsigned int block_size);
+
+    /**
+     * @brief Sets the number of frames in one block, when it is not known at construction. It also resets the
+     * scheduler.
+     */
+    void setBlockSize(unsigned int new_block_size);
+
+    /**
+     * @brief Sets the new schedule. The current phase is continued and its blocks are counted with the new schedule.
+     */
+    void setSchedule(const LearningSchedule &new_schedule);
+
+    [[nodiscard]] const LearningSchedule &getSchedule() const;
+
+    /**
+     * @brief True if masks are learnt with the last frame passed to <b>nextFrame()</b>.
+     */
+    [[nodiscard]] bool isLearning() const;
+
+    /**
+     * @brief Selects the phase for the next frame.
+     * @param position Position of the frame in the block. 0 for the first frame (to which no mask is applied).
+     * @param brightness Function returning mean brightness of the frame. It is called only by the change detector
+     * while learning is frozen, so other frames are not read.
+     * @return True if learning is resumed with this frame, so the history of frames must be cleared first.
+     */
+    bool nextFrame(unsigned int position, const std::function<double()> &brightness);
+
+    /**
+     * @brief Starts the learning phase, so processing can start over.
+     */
+    void reset();
+};
+
+
+#endif //LEARNING_SCHEDULER_HPP
@@ -0,0 +1,80 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#include "load_shedder.hpp"
+
+LoadShedder::LoadShedder() : policy{0, 0, 0}, counters{0, 0, 0, 0, 0}, action(OverloadAction::NONE), lag(0)
+{
+}
+
+bool LoadShedder::setPolicy(const OverloadPolicy &new_policy, std::string &error)
+{
+    if(new_policy.apply_only_lag < 0 || new_policy.drop_block_lag < 0 || new_policy.recovery_lag < 0) {
+        error = "Overload policy cannot be set. Lags cannot be negative.";
+        return false;
+    }
+    if((new_policy.apply_only_lag > 0 && new_policy.recovery_lag > new_policy.apply_only_lag) ||
+       (new_policy.drop_block_lag > 0 && new_policy.recovery_lag > new_policy.drop_block_lag)) {
+        error = "Overload policy cannot be set. Recovery lag cannot be bigger than lags of enabled actions.";
+        return false;
+    }
+    policy = new_policy;
+    return true;
+}
+
+const OverloadPolicy &LoadShedder::getPolicy() const
+{
+    return policy;
+}
+
+const OverloadCounters &LoadShedder::getCounters() const
+{
+    return counters;
+}
+
+void LoadShedder::setLag(double new_lag)
+{
+    lag = new_lag;
+}
+
+OverloadAction LoadShedder::getAction() const
+{
+    return action;
+}
+
+bool LoadShedder::nextFrame(unsigned int position)
+{
+    const OverloadAction last_action = action;
+    //blocks are dropped whole, so the action changes inside dropped blocks only at their end
+    if(action != OverloadAction::DROP_BLOCK || position == 0) {
+        if(position == 0 && policy.drop_block_lag > 0 && lag > policy.drop_block_lag) {
+            action = OverloadAction::DROP_BLOCK;
+            counters.dropped_blocks++;
+        } else if((policy.apply_only_lag > 0 && lag > policy.apply_only_lag) ||
+                  (last_action != OverloadAction::NONE && lag > policy.recovery_lag)) {
+            action = OverloadAction::APPLY_ONLY;
+            if(last_action != OverloadAction::APPLY_ONLY) {
+                counters.apply_only_activations++;
+            }
+        } else {
+            action = OverloadAction::NONE;
+        }
+    }
+
+    if(action == OverloadAction::DROP_BLOCK) {
+        counters.dropped_frames++;
+    } else if(action == OverloadAction::APPLY_ONLY) {
+        counters.apply_only_frames++;
+    } else if(last_action != OverloadAction::NONE) {
+        counters.recoveries++;
+        return true;
+    }
+    return false;
+}
+
+void LoadShedder::reset()
+{
+    action = OverloadAction::NONE;
+    lag = 0;
+}
@@ -0,0 +1,147 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#ifndef LOAD_SHEDDER_HPP
+#define LOAD_SHEDDER_HPP
+
+#include <string>
+
+/**
+ * @brief Policy of flicker removers for frames arriving faster than they can be processed. Lags are given in
+ * milliseconds, for example as the age of the next frame waiting in the input queue. Thresholds equal to 0 disable
+ * the policy.
+ */
+struct OverloadPolicy {
+    /**
+     * @brief Lag above which masks are only applied to frames, so similarity levels, flicker counters and masks are not
+     * updated.
+     */
+    double apply_only_lag;
+
+    /**
+     * @brief Lag above which whole blocks of frames are dropped. Blocks are dropped from their first frame, so dropped
+     * frames never split the block and the mask phase is kept.
+     */
+    double drop_block_lag;
+
+    /**
+     * @brief Lag below which masks are learnt again. Until then frames are only applied, also after dropped blocks.
+     * It must not be bigger than enabled thresholds.
+     */
+    double recovery_lag;
+};
+
+/**
+ * @brief Numbers of times the overload policy fired.
+ */
+struct OverloadCounters {
+    /**
+     * @brief Number of switches to apply-only processing and number of frames processed this way.
+     */
+    unsigned long apply_only_activations;
+    unsigned long apply_only_frames;
+
+    /**
+     * @brief Number of dropped blocks and number of frames dropped with them.
+     */
+    unsigned long dropped_blocks;
+    unsigned long dropped_frames;
+
+    /**
+     * @brief Number of times learning was resumed after the lag recovered.
+     */
+    unsigned long recoveries;
+};
+
+/**
+ * @brief Action of the overload policy for one frame.
+ */
+enum class OverloadAction {
+    /**
+     * @brief The frame is processed normally.
+     */
+    NONE,
+
+    /**
+     * @brief The mask is applied to the frame, but the frame is not used to learn masks.
+     */
+    APPLY_ONLY,
+
+    /**
+     * @brief The frame is not processed at all.
+     */
+    DROP_BLOCK
+};
+
+/**
+ * @brief Selects the action of <b>OverloadPolicy</b> for every frame based on the last reported lag of the input.
+ * Every frame skipped from learning breaks the sequence of historical frames, so history must be gathered again when
+ * learning is resumed.
+ */
+class LoadShedder {
+protected:
+    /**
+     * @brief Current policy.
+     */
+    OverloadPolicy policy;
+
+    /**
+     * @brief Counters of fired actions.
+     */
+    OverloadCounters counters;
+
+    /**
+     * @brief Action selected for the last frame.
+     */
+    OverloadAction action;
+
+    /**
+     * @brief Last reported lag of the input in milliseconds.
+     */
+    double lag;
+
+public:
+    /**
+     * @brief Constructor. The policy is disabled until it is set.
+     */
+    LoadShedder();
+
+    /**
+     * @brief Sets the new policy.
+     * @param new_policy New policy.
+     * @param error Returned description of the problem if an error occurs.
+     * @return True if the policy was set, false if its thresholds are invalid.
+     */
+    bool setPolicy(const OverloadPolicy &new_policy, std::string &error);
+
+    [[nodiscard]] const OverloadPolicy &getPolicy() const;
+
+    [[nodiscard]] const OverloadCounters &getCounters() const;
+
+    /**
+     * @brief Reports the lag of the input used for the next frames.
+     * @param new_lag Lag in milliseconds.
+     */
+    void setLag(double new_lag);
+
+    /**
+     * @brief Action selected for the last frame passed to <b>nextFrame()</b>.
+     */
+    [[nodiscard]] OverloadAction getAction() const;
+
+    /**
+     * @brief Selects the action for the next frame.
+     * @param position Position of the frame in the block. 0 for the first frame (to which no mask is applied).
+     * @return True if learning is resumed with this frame, so the history of frames must be cleared first.
+     */
+    bool nextFrame(unsigned int position);
+
+    /**
+     * @brief Resumes normal processing and forgets the reported lag. Counters are kept.
+     */
+    void reset();
+};
+
+
+#endif //LOAD_SHEDDER_HPP
@@ -1,10 +1,17 @@
+#include <condition_variable>
+#include <deque>
 #include <filesystem>
+#include <memory>
+#include <mutex>
 #include <opencv2/opencv.hpp>
 #include <sys/time.h>
-#include "circular_buffer.hpp"
+#include <thread>
 #include "open_cl_kernels.hpp"
 #include "flicker_remover.hpp"
 #include "flicker_remover_cpu.hpp"
+#include "cpu_kernels.hpp"
+#include "spsc_circular_buffer.hpp"
+#include "segmented_flicker_remover.hpp"
 
 using namespace cv;
 using namespace std::filesystem;
@@ -197,9 +204,17 @@ bool iterateVideoFrames(VideoCapture &video_capture, const function<bool(const M
 }
 
 int flickerRemoverOnCPU(bool images_from_dir, VideoCapture &video_capture, const vector<path> &filenames,
-                        unsigned int fps, int rows, int cols)
+                        unsigned int fps, int rows, int cols, FrameLayout frame_layout, unsigned int learning_scale = 1)
 {
-    FlickerRemoverCPU flicker_remover(fps, 5, 3, rows, cols);
+    FlickerRemoverCPU flicker_remover(fps, 5, 3, rows, cols, FrameStorage::WIDE, SimilarityCounters::BYTES,
+                                      frame_layout, nullptr, learning_scale);
+    //masks learnt at reduced resolution are compared with masks learnt at full resolution by the reference remover
+    std::unique_ptr<FlickerRemoverCPU> reference_remover;
+    if(learning_scale > 1) {
+        reference_remover.reset(new FlickerRemoverCPU(fps, 5, 3, rows, cols, FrameStorage::WIDE,
+                                                      SimilarityCounters::BYTES, frame_layout));
+    }
+    cout << "Instruction set of CPU kernels: " << CPUKernels::getInstructionSet() << endl;
     auto skip_frames = flicker_remover.getWarmUpDuration();
 
     VideoWriter video_orig("orig.avi", VideoWriter::fourcc('M', 'J', 'P', 'G'), fps, Size(cols, rows), false);
@@ -220,13 +235,14 @@ int flickerRemoverOnCPU(bool images_from_dir, VideoCapture &video_capture, const
     double fake_timestamp = 34.0;
     unsigned int frame_number = 0;
     Mat prev_orig;
-    Mat *prev_frame = nullptr;
-    CircularBuffer<Mat *> to_delete_in_future(flicker_remover.getNumberOfStoredFrames());
+    Mat prev_frame;
     double total_time = 0;
     bool was_error = false;
     double norm_sum = 0;
     double orig_norm_sum = 0;
+    double reference_norm_sum = 0;
     unsigned int norm_count = 0;
+    Mat prev_reference_frame;
     while(!images_from_dir || frame_number < filenames.size()) {
         Mat orig_frame;
         if(images_from_dir) {
@@ -246,17 +262,25 @@ int flickerRemoverOnCPU(bool images_from_dir, VideoCapture &video_capture, const
 
         string error;
         auto start = wallTime();
-        Mat *frame_without_flickering = flicker_remover.removeFlickering(orig_frame, fake_timestamp, error);
+        Mat frame_without_flickering;
+        bool removed = flicker_remover.removeFlickering(orig_frame, fake_timestamp, frame_without_flickering, error);
         auto end = wallTime();
         total_time += (end - start);
-        if(frame_without_flickering == nullptr) {
+        if(!removed) {
             cout << "Flicker remover reported an error: " << error << endl;
             was_error = true;
             break;
         }
+        Mat reference_frame;
+        if(reference_remover != nullptr &&
+           !reference_remover->removeFlickering(orig_frame, fake_timestamp, reference_frame, error)) {
+            cout << "Reference flicker remover reported an error: " << error << endl;
+            was_error = true;
+            break;
+        }
 
         Mat frame_without_flickering_8u;
-        frame_without_flickering->convertTo(frame_without_flickering_8u, CV_8UC1);
+        frame_without_flickering.convertTo(frame_without_flickering_8u, CV_8UC1);
         imshow("image with removed flickering", frame_without_flickering_8u);
         imshow("original image", orig_frame);
         waitKey(1);
@@ -264,11 +288,11 @@ int flickerRemoverOnCPU(bool images_from_dir, VideoCapture &video_capture, const
         video_orig.write(orig_frame);
         video_flicker_free.write(frame_without_flickering_8u);
 
-        if(prev_frame != nullptr) {
+        if(!prev_frame.empty()) {
             if(skip_frames < frame_number) {
                 Mat mask;
                 if(flicker_remover.getMaskOfStaticPixelsOfLastPairOfFrames(mask, error)) {
-                    norm_sum += norm(*prev_frame, *frame_without_flickering, mask);
+                    norm_sum += norm(prev_frame, frame_without_flickering, mask);
                     orig_norm_sum += norm(prev_orig, orig_frame, mask);
                     norm_count++;
                 } else {
@@ -276,9 +300,19 @@ int flickerRemoverOnCPU(bool images_from_dir, VideoCapture &video_capture, const
                     was_error = true;
                     break;
                 }
+                if(reference_remover != nullptr) {
+                    Mat reference_mask;
+                    if(reference_remover->getMaskOfStaticPixelsOfLastPairOfFrames(reference_mask, error)) {
+                        reference_norm_sum += norm(prev_reference_frame, reference_frame, reference_mask);
+                    } else {
+                        cout << error << endl;
+                        was_error = true;
+                        break;
+                    }
+                }
             }
             Mat prev_frame_8u;
-            prev_frame->convertTo(prev_frame_8u, CV_8UC1);
+            prev_frame.convertTo(prev_frame_8u, CV_8UC1);
             Mat diff;
             absdiff(prev_frame_8u, frame_without_flickering_8u, diff);
             Mat filtered_diff(diff.rows, diff.cols, diff.type());
@@ -313,18 +347,11 @@ int flickerRemoverOnCPU(bool images_from_dir, VideoCapture &video_capture, const
             video_combined.write(v3);
         }
         orig_frame.copyTo(prev_orig);
-        auto to_delete = to_delete_in_future.push(prev_frame);
-        delete to_delete;
         prev_frame = frame_without_flickering;
+        prev_reference_frame = reference_frame;
         fake_timestamp += timestamps_delta;
         frame_number++;
     }
-    delete prev_frame;
-    auto to_delete = to_delete_in_future.pop();
-    while(to_delete != nullptr) {
-        delete to_delete;
-        to_delete = to_delete_in_future.pop();
-    }
     video_orig.release();
     video_flicker_free.release();
     video_diff.release();
@@ -339,6 +366,13 @@ int flickerRemoverOnCPU(bool images_from_dir, VideoCapture &video_capture, const
             if(frame_number > skip_frames) {
                 cout << " Norm with flicker removal: " << (norm_sum / norm_count);
                 cout << " Norm without flicker removal: " << (orig_norm_sum / norm_count);
+                if(reference_remover != nullptr) {
+                    cout << " Norm with masks learnt at full resolution: " << (reference_norm_sum / norm_count);
+                    if(reference_norm_sum > 0) {
+                        cout << " Change of norm: " << (100 * (norm_sum - reference_norm_sum) / reference_norm_sum)
+                             << "%";
+                    }
+                }
             }
         }
         cout << endl;
@@ -372,8 +406,7 @@ int flickerRemoverOnGPU(bool images_from_dir, VideoCapture &video_capture, const
     double fake_timestamp = 34.0;
     unsigned int frame_number = 0;
     Mat prev_orig;
-    UMat *prev_frame = nullptr;
-    CircularBuffer<UMat *> to_delete_in_future(flicker_remover.getNumberOfStoredFrames());
+    UMat prev_frame;
     double total_time = 0;
     bool was_error = false;
     double norm_sum = 0;
@@ -398,28 +431,29 @@ int flickerRemoverOnGPU(bool images_from_dir, VideoCapture &video_capture, const
 
         string error;
         auto start = wallTime();
-        UMat *frame_without_flickering = flicker_remover.removeFlickering(orig_frame.getUMat(ACCESS_READ),
-                                                                          fake_timestamp, error);
+        UMat frame_without_flickering;
+        bool removed = flicker_remover.removeFlickering(orig_frame.getUMat(ACCESS_READ), fake_timestamp,
+                                                        frame_without_flickering, error);
         auto end = wallTime();
         total_time += (end - start);
-        if(frame_without_flickering == nullptr) {
+        if(!removed) {
             cout << "Flicker remover reported an error: " << error << endl;
             was_error = true;
             break;
         }
 
-        imshow("image with removed flickering", *frame_without_flickering);
+        imshow("image with removed flickering", frame_without_flickering);
         imshow("original image", orig_frame);
         waitKey(1);
 
         video_orig.write(orig_frame);
-        video_flicker_free.write(*frame_without_flickering);
+        video_flicker_free.write(frame_without_flickering);
 
-        if(prev_frame != nullptr) {
+        if(!prev_frame.empty()) {
             if(skip_frames < frame_number) {
                 Mat mask;
                 if(flicker_remover.getMaskOfStaticPixelsOfLastPairOfFrames(mask, error)) {
-                    norm_sum += norm(prev_frame->getMat(ACCESS_READ), frame_without_flickering->getMat(ACCESS_READ),
+                    norm_sum += norm(prev_frame.getMat(ACCESS_READ), frame_without_flickering.getMat(ACCESS_READ),
                                      mask);
                     orig_norm_sum += norm(prev_orig, orig_frame, mask);
                     norm_count++;
@@ -431,7 +465,7 @@ int flickerRemoverOnGPU(bool images_from_dir, VideoCapture &video_capture, const
             }
 
             UMat diff;
-            absdiff(*prev_frame, *frame_without_flickering, diff);
+            absdiff(prev_frame, frame_without_flickering, diff);
             UMat filtered_diff(diff.rows, diff.cols, diff.type());
             if(!opencl_kernels.runKernelCalculateFilteredDiff(diff, low_threshold, second_neighbours_limit,
                                                               filtered_diff, error)) {
@@ -444,7 +478,7 @@ int flickerRemoverOnGPU(bool images_from_dir, VideoCapture &video_capture, const
             waitKey(1);
             video_diff.write(filtered_diff);
             Mat v1, v2, v3;
-            hconcat(orig_frame, *frame_without_flickering, v1);
+            hconcat(orig_frame, frame_without_flickering, v1);
             Mat diff_orig;
             absdiff(prev_orig, orig_frame, diff_orig);
             diff_orig.forEach<unsigned char>([](unsigned char &value, const int *position) {
@@ -458,18 +492,10 @@ int flickerRemoverOnGPU(bool images_from_dir, VideoCapture &video_capture, const
             video_combined.write(v3);
         }
         orig_frame.copyTo(prev_orig);
-        auto to_delete = to_delete_in_future.push(prev_frame);
-        delete to_delete;
         prev_frame = frame_without_flickering;
         fake_timestamp += timestamps_delta;
         frame_number++;
     }
-    delete prev_frame;
-    auto to_delete = to_delete_in_future.pop();
-    while(to_delete != nullptr) {
-        delete to_delete;
-        to_delete = to_delete_in_future.pop();
-    }
     video_orig.release();
     video_flicker_free.release();
     video_diff.release();
@@ -491,6 +517,223 @@ int flickerRemoverOnGPU(bool images_from_dir, VideoCapture &video_capture, const
     }
 }
 
+/**
+ * @brief Bounded queue of pointers to frames guarded by a mutex, the baseline for the lock-free buffer.
+ */
+class MutexQueue {
+    std::mutex guard;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<const Mat *> frames;
+    const size_t capacity;
+public:
+    explicit MutexQueue(size_t capacity) : capacity(capacity)
+    {
+    }
+
+    void push(const Mat *frame)
+    {
+        std::unique_lock<std::mutex> lock(guard);
+        not_full.wait(lock, [this] { return frames.size() < capacity; });
+        frames.push_back(frame);
+        lock.unlock();
+        not_empty.notify_one();
+    }
+
+    const Mat *pop()
+    {
+        std::unique_lock<std::mutex> lock(guard);
+        not_empty.wait(lock, [this] { return !frames.empty(); });
+        const Mat *frame = frames.front();
+        frames.pop_front();
+        lock.unlock();
+        not_full.notify_one();
+        return frame;
+    }
+};
+
+/**
+ * @brief Measures hand-off of frames from the capturing thread to the processing thread through the lock-free
+ * SPSCCircularBuffer and through the queue guarded by a mutex. Frames are read once and then passed many times, the
+ * processing thread only reads one pixel of every frame, so the time is dominated by the hand-off itself.
+ */
+int handOffBenchmark(bool images_from_dir, VideoCapture &video_capture, const vector<path> &filenames)
+{
+    const unsigned int max_frames = 64;
+    const unsigned int capacity = 8;
+    const unsigned int hand_offs = 1000000;
+
+    vector<Mat> frames;
+    while(frames.size() < max_frames && (!images_from_dir || frames.size() < filenames.size())) {
+        Mat frame;
+        if(images_from_dir) {
+            if(!readImage(filenames, (unsigned int) frames.size(), frame)) {
+                return -1;
+            }
+        } else {
+            if(!readVideoFrame(video_capture, frame)) {
+                return -1;
+            }
+            if(frame.empty()) {
+                break;
+            }
+        }
+        frames.push_back(frame);
+    }
+    if(frames.empty()) {
+        cerr << "No frames to pass between threads." << endl;
+        return -1;
+    }
+
+    //pop() returns nullptr when the buffer is empty, so the end of the stream is marked with a pointer past the frames
+    const Mat *end_marker = frames.data() + frames.size();
+    SPSCCircularBuffer<const Mat *> buffer(capacity);
+    unsigned long spsc_checksum = 0;
+    auto start = wallTime();
+    thread spsc_consumer([&] {
+        while(true) {
+            const Mat *frame = buffer.pop();
+            if(frame == nullptr) {
+                this_thread::yield();
+                continue;
+            }
+            if(frame == end_marker) {
+                break;
+            }
+            spsc_checksum += frame->data[0];
+        }
+    });
+    for(unsigned int i = 0; i <= hand_offs; i++) {
+        const Mat *frame = i < hand_offs ? &frames[i % frames.size()] : end_marker;
+        while(!buffer.push(frame)) {
+            this_thread::yield();
+        }
+    }
+    spsc_consumer.join();
+    double spsc_time = wallTime() - start;
+
+    //the mutex-guarded queue may pass nullptr, so it marks the end
+    MutexQueue queue(capacity);
+    unsigned long mutex_checksum = 0;
+    start = wallTime();
+    thread mutex_consumer([&] {
+        while(true) {
+            const Mat *frame = queue.pop();
+            if(frame == nullptr) {
+                break;
+            }
+            mutex_checksum += frame->data[0];
+        }
+    });
+    for(unsigned int i = 0; i < hand_offs; i++) {
+        queue.push(&frames[i % frames.size()]);
+    }
+    queue.push(nullptr);
+    mutex_consumer.join();
+    double mutex_time = wallTime() - start;
+
+    if(spsc_checksum != mutex_checksum) {
+        cerr << "Frames passed through both queues differ." << endl;
+        return -1;
+    }
+    cout << "Hand-off of " << hand_offs << " frames through " << capacity << " slots." << endl;
+    cout << "Lock-free SPSC buffer: " << spsc_time << " s, " << (1e9 * spsc_time / hand_offs) << " ns per frame."
+         << endl;
+    cout << "Queue guarded by mutex: " << mutex_time << " s, " << (1e9 * mutex_time / hand_offs) << " ns per frame."
+         << endl;
+    return 0;
+}
+
+/**
+ * @brief Removes flickering from the whole recording split into segments processed in parallel and compares the
+ * stitched result with the sequential run. All frames are read into memory first, so both runs get the same frames
+ * and only processing is timed.
+ */
+int segmentedFlickerRemoverOnCPU(bool images_from_dir, VideoCapture &video_capture, const vector<path> &filenames,
+                                 unsigned int fps, int rows, int cols)
+{
+    vector<Mat> frames;
+    while(!images_from_dir || frames.size() < filenames.size()) {
+        Mat frame;
+        if(images_from_dir) {
+            if(!readImage(filenames, (unsigned int) frames.size(), frame)) {
+                return -1;
+            }
+        } else {
+            if(!readVideoFrame(video_capture, frame)) {
+                return -1;
+            }
+            if(frame.empty()) {
+                break;
+            }
+        }
+        frames.push_back(frame);
+    }
+    const double timestamps_delta = 1000. / fps;
+    const double first_timestamp = 34.0;
+
+    FlickerRemoverCPU flicker_remover(fps, 5, 3, rows, cols);
+    vector<Mat> sequential_frames(frames.size());
+    string error;
+    auto start = wallTime();
+    for(size_t i = 0; i < frames.size(); i++) {
+        Mat frame_without_flickering;
+        if(!flicker_remover.removeFlickering(frames[i], first_timestamp + (double) i * timestamps_delta,
+                                             frame_without_flickering, error)) {
+            cout << "Flicker remover reported an error: " << error << endl;
+            return -1;
+        }
+        frame_without_flickering.convertTo(sequential_frames[i], CV_8UC1);
+    }
+    double sequential_time = wallTime() - start;
+
+    ThreadPool thread_pool;
+    SegmentedFlickerRemover segmented_flicker_remover(thread_pool, fps, 5, 3, rows, cols);
+    vector<Mat> segmented_frames(frames.size());
+    start = wallTime();
+    bool removed = segmented_flicker_remover.process(
+            frames.size(), thread_pool.getNumberOfThreads(),
+            [&frames, first_timestamp, timestamps_delta](unsigned int, unsigned long index, Mat &frame,
+                                                         double &timestamp, string &) {
+                frame = frames[index];
+                timestamp = first_timestamp + (double) index * timestamps_delta;
+                return true;
+            },
+            //every frame has its own slot, so segments write without synchronization
+            [&segmented_frames](unsigned int, unsigned long index, const Mat &frame, string &) {
+                frame.convertTo(segmented_frames[index], CV_8UC1);
+                return true;
+            }, error);
+    double segmented_time = wallTime() - start;
+    if(!removed) {
+        cout << "Segmented flicker remover reported an error: " << error << endl;
+        return -1;
+    }
+
+    VideoWriter video_flicker_free("flicker_free.avi", VideoWriter::fourcc('M', 'J', 'P', 'G'), fps, Size(cols, rows),
+                                   false);
+    unsigned int different_frames = 0;
+    double difference_sum = 0;
+    for(size_t i = 0; i < frames.size(); i++) {
+        video_flicker_free.write(segmented_frames[i]);
+        double difference = cv::norm(sequential_frames[i], segmented_frames[i], NORM_L1);
+        if(difference > 0) {
+            different_frames++;
+        }
+        difference_sum += difference;
+    }
+    video_flicker_free.release();
+
+    cout << "Sequential run: " << sequential_time << " s. Segmented run: " << segmented_time << " s with "
+         << thread_pool.getNumberOfThreads() << " threads for: " << frames.size() << " frames." << endl;
+    cout << "Frames different than in the sequential run: " << different_frames;
+    if(!frames.empty()) {
+        cout << " Mean absolute difference of pixels: " << (difference_sum / frames.size() / rows / cols);
+    }
+    cout << endl;
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
     vector<path> filenames;
@@ -507,6 +750,11 @@ int main(int argc, char *argv[])
              << "2 - simple diff with all pixels with values different than 0 (black) set to 255 (white)" << endl
              << "3 - flicker remover on CPU" << endl
              << "4 - flicker remover on GPU" << endl
+             << "5 - flicker remover on CPU with interleaved history of frames" << endl
+             << "6 - flicker remover on CPU learning masks at 2x reduced resolution" << endl
+             << "7 - flicker remover on CPU learning masks at 4x reduced resolution" << endl
+             << "8 - benchmark of passing frames between threads through lock-free and mutex-guarded queues" << endl
+             << "9 - flicker remover on CPU processing segments of the recording in parallel" << endl
              << "IMPORTANT: all images and videos should be in << " << cols << "x" << rows << " pixel format." << endl;
         return -1;
     }
@@ -608,13 +856,32 @@ int main(int argc, char *argv[])
             }
         case 3:
             cout << "Flicker remover on CPU." << endl;
-            return flickerRemoverOnCPU(images_from_dir, video_capture, filenames, fps, rows, cols);
+            return flickerRemoverOnCPU(images_from_dir, video_capture, filenames, fps, rows, cols,
+                                       FrameLayout::PLANAR);
         case 4:
             cout << "Flicker remover on GPU." << endl;
             return flickerRemoverOnGPU(images_from_dir, video_capture, filenames, fps, rows, cols);
+        case 5:
+            cout << "Flicker remover on CPU with interleaved history of frames." << endl;
+            return flickerRemoverOnCPU(images_from_dir, video_capture, filenames, fps, rows, cols,
+                                       FrameLayout::INTERLEAVED);
+        case 6:
+            cout << "Flicker remover on CPU learning masks at 2x reduced resolution." << endl;
+            return flickerRemoverOnCPU(images_from_dir, video_capture, filenames, fps, rows, cols,
+                                       FrameLayout::PLANAR, 2);
+        case 7:
+            cout << "Flicker remover on CPU learning masks at 4x reduced resolution." << endl;
+            return flickerRemoverOnCPU(images_from_dir, video_capture, filenames, fps, rows, cols,
+                                       FrameLayout::PLANAR, 4);
+        case 8:
+            cout << "Benchmark of passing frames between threads." << endl;
+            return handOffBenchmark(images_from_dir, video_capture, filenames);
+        case 9:
+            cout << "Flicker remover on CPU processing segments of the recording in parallel." << endl;
+            return segmentedFlickerRemoverOnCPU(images_from_dir, video_capture, filenames, fps, rows, cols);
         default:
             cout << "Unknown execution mode: " << execution_mode_string
-                 << ". It should be an integral value from range: 1 - 6." << endl;
+                 << ". It should be an integral value from range: 1 - 9." << endl;
             return -1;
     }
 }
\ No newline at end of file
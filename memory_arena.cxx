@@ -0,0 +1,105 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#include "memory_arena.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+/**
+ * @brief Rounds the size up to the multiple of the alignment, which is a power of 2.
+ */
+size_t alignUp(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+void *alignedAlloc(size_t alignment, size_t size)
+{
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    return std::aligned_alloc(alignment, size);
+#endif
+}
+
+void alignedFree(void *data)
+{
+#ifdef _WIN32
+    _aligned_free(data);
+#else
+    std::free(data);
+#endif
+}
+}
+
+MemoryArena::MemoryArena() : size(0), data(nullptr), huge_pages(false)
+{
+}
+
+MemoryArena::~MemoryArena()
+{
+    alignedFree(data);
+}
+
+unsigned int MemoryArena::reserve(size_t plane_size, size_t tile_size)
+{
+    if(data != nullptr) {
+        throw std::logic_error("Planes cannot be reserved after allocation.");
+    }
+    planes.push_back(Plane{size, plane_size, tile_size});
+    size = alignUp(size + plane_size, ALIGNMENT);
+    return (unsigned int) planes.size() - 1;
+}
+
+void MemoryArena::allocate(MemoryPages pages)
+{
+    size_t alignment = ALIGNMENT;
+    if(pages == MemoryPages::TRANSPARENT_HUGE) {
+        alignment = HUGE_PAGE_SIZE;
+        size = alignUp(size, HUGE_PAGE_SIZE);
+    }
+    //memory is not zeroed here, so its pages are not touched until touchTiles()
+    data = (unsigned char *) alignedAlloc(alignment, std::max(size, alignment));
+    if(data == nullptr) {
+        throw std::bad_alloc();
+    }
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    //only a hint, without transparent huge pages in the system memory is backed by normal pages
+    huge_pages = pages == MemoryPages::TRANSPARENT_HUGE && madvise(data, size, MADV_HUGEPAGE) == 0;
+#endif
+}
+
+void *MemoryArena::getPlane(unsigned int plane) const
+{
+    return data + planes[plane].offset;
+}
+
+void MemoryArena::touchTiles(unsigned int first_tile, unsigned int end_tile)
+{
+    for(const Plane &plane: planes) {
+        const size_t begin = std::min(plane.size, first_tile * plane.tile_size);
+        const size_t end = std::min(plane.size, end_tile * plane.tile_size);
+        std::memset(data + plane.offset + begin, 0, end - begin);
+    }
+}
+
+size_t MemoryArena::getSize() const
+{
+    return size;
+}
+
+bool MemoryArena::usesHugePages() const
+{
+    return huge_pages;
+}
@@ -0,0 +1,123 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#ifndef MEMORY_ARENA_HPP
+#define MEMORY_ARENA_HPP
+
+#include <cstddef>
+#include <vector>
+
+using std::vector;
+
+/**
+ * @brief Pages backing the memory of the flicker remover.
+ */
+enum class MemoryPages {
+    /**
+     * @brief Pages of the default size.
+     */
+    NORMAL,
+
+    /**
+     * @brief Transparent huge pages (2 MB on x86). One huge page replaces hundreds of TLB entries, so with many
+     * streams fewer TLB misses occur. They are only a hint, if the system does not provide them normal pages are used.
+     */
+    TRANSPARENT_HUGE
+};
+
+/**
+ * @brief One aligned block of memory from which all planes of one flicker remover are carved.
+ *
+ * Planes are reserved first, then the whole block is allocated at once. Every plane starts at the cache line boundary
+ * and is divided into tiles of the same number of bytes, which correspond to tiles of pixels of the frame. Memory is
+ * not touched by the allocation, so <b>touchTiles()</b> called by threads processing the tiles zeroes it and, with the
+ * first touch policy of the system, makes pages local to the NUMA node of these threads.
+ */
+class MemoryArena {
+protected:
+    /**
+     * @brief Reserved plane.
+     */
+    struct Plane {
+        size_t offset;
+        size_t size;
+        size_t tile_size;
+    };
+
+    vector<Plane> planes;
+
+    /**
+     * @brief Size of the allocated block in bytes.
+     */
+    size_t size;
+
+    unsigned char *data;
+
+    /**
+     * @brief True if the system was asked to back the block with huge pages.
+     */
+    bool huge_pages;
+
+public:
+    /**
+     * @brief Alignment of every plane.
+     */
+    static const size_t ALIGNMENT = 64;
+
+    /**
+     * @brief Size of the huge page, the block is aligned to it and its size is rounded up to it.
+     */
+    static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    MemoryArena();
+    MemoryArena(const MemoryArena &) = delete;
+    MemoryArena &operator=(const MemoryArena &) = delete;
+    ~MemoryArena();
+
+    /**
+     * @brief Reserves the plane. It can be called only before <b>allocate()</b>.
+     * @param plane_size Size of the plane in bytes.
+     * @param tile_size Number of bytes of every tile of the plane. The last tile may be shorter.
+     * @return Index of the plane.
+     */
+    unsigned int reserve(size_t plane_size, size_t tile_size);
+
+    /**
+     * @brief Allocates memory of all reserved planes. Throws std::bad_alloc if it fails.
+     * @param pages Pages backing the memory.
+     */
+    void allocate(MemoryPages pages);
+
+    /**
+     * @brief Returns the first byte of the plane.
+     * @param plane Index of the plane returned by <b>reserve()</b>.
+     */
+    [[nodiscard]] void *getPlane(unsigned int plane) const;
+
+    template<typename T>
+    [[nodiscard]] T *getPlane(unsigned int plane) const
+    {
+        return (T *) getPlane(plane);
+    }
+
+    /**
+     * @brief Zeroes tiles of all planes. Every tile should be touched by the thread which will process it.
+     * @param first_tile First zeroed tile.
+     * @param end_tile Tile after the last zeroed one.
+     */
+    void touchTiles(unsigned int first_tile, unsigned int end_tile);
+
+    /**
+     * @brief Size of the allocated memory in bytes.
+     */
+    [[nodiscard]] size_t getSize() const;
+
+    /**
+     * @brief True if the system was asked to back the memory with huge pages.
+     */
+    [[nodiscard]] bool usesHugePages() const;
+};
+
+
+#endif //MEMORY_ARENA_HPP
@@ -10,6 +10,8 @@
 
 using namespace std;
 
+const int OpenCLKernels::MASK_TILE_SIZE = 16;
+
 const char *OpenCLKernels::kernels_src =
         "unsigned int number_of_white_neighbours(\n"
         "       __global const uchar* image,\n"
@@ -106,7 +108,9 @@ const char *OpenCLKernels::kernels_src =
         "       __global const uchar* src_frame_2, int src_frame_2_step, int src_frame_2_offset,\n"
         "       __global const uchar* flicker, int flicker_step, int flicker_offset,\n"
         "       int max_duration,\n"
-        "       __global short* dst_mask, int dst_mask_step, int dst_mask_offset)\n"
+        "       __global short* dst_mask, int dst_mask_step, int dst_mask_offset,\n"
+        "       int tile_size,\n"
+        "       __global uchar* refined_tiles, int refined_tiles_step, int refined_tiles_offset)\n"
         "{\n"
         "   int x = get_global_id(0);\n"
         "   int y = get_global_id(1);\n"
@@ -115,8 +119,33 @@ const char *OpenCLKernels::kernels_src =
         "       int src_frame_1_idx = y * src_frame_1_step + x + src_frame_1_offset;\n"
         "       int src_frame_2_idx = y * src_frame_2_step + x + src_frame_2_offset;\n"
         "       int dst_mask_idx = y * dst_mask_step / 2 + x + dst_mask_offset / 2;\n"
+        "       int refined_tiles_idx = (y / tile_size) * refined_tiles_step + x / tile_size + refined_tiles_offset;\n"
         "       dst_mask[dst_mask_idx] += src_frame_2[src_frame_2_idx];\n"
         "       dst_mask[dst_mask_idx] -= src_frame_1[src_frame_1_idx];\n"
+        "       refined_tiles[refined_tiles_idx] = 1;\n"
+        "   }\n"
+        "}\n"
+        "\n"
+        "__kernel void apply_mask(\n"
+        "       __global const uchar* src, int src_step, int src_offset, int src_rows, int src_cols,\n"
+        "       __global const short* mask, int mask_step, int mask_offset,\n"
+        "       int tile_size,\n"
+        "       __global const uchar* refined_tiles, int refined_tiles_step, int refined_tiles_offset,\n"
+        "       __global uchar* dst, int dst_step, int dst_offset)\n"
+        "{\n"
+        "   int x = get_global_id(0);\n"
+        "   int y = get_global_id(1);\n"
+        "   if(x >= src_cols || y >= src_rows) {\n"
+        "       return;\n"
+        "   }\n"
+        "   int src_idx = y * src_step + x + src_offset;\n"
+        "   int dst_idx = y * dst_step + x + dst_offset;\n"
+        "   int refined_tiles_idx = (y / tile_size) * refined_tiles_step + x / tile_size + refined_tiles_offset;\n"
+        "   if(refined_tiles[refined_tiles_idx] != 0) {\n"
+        "       int mask_idx = y * mask_step / 2 + x + mask_offset / 2;\n"
+        "       dst[dst_idx] = convert_uchar_sat((int) src[src_idx] - (int) mask[mask_idx]);\n"
+        "   } else {\n"
+        "       dst[dst_idx] = src[src_idx];\n"
         "   }\n"
         "}\n"
         "\n"
@@ -304,6 +333,13 @@ void OpenCLKernels::initOpenCL()
         return;
     }
 
+    kernel_apply_mask = cv::ocl::Kernel("apply_mask", program);
+    if(kernel_apply_mask.empty()) {
+        availability_error = "Could not get kernel: apply_mask.";
+        opencl_available = false;
+        return;
+    }
+
     kernel_zero_flicker_counter = cv::ocl::Kernel("zero_flicker_counter", program);
     if(kernel_zero_flicker_counter.empty()) {
         availability_error = "Could not get kernel: zero_flicker_counter.";
@@ -391,7 +427,7 @@ bool OpenCLKernels::runKernelUpdateFlickerCounter(const UMat &adjacent_frames_si
 }
 
 bool OpenCLKernels::runKernelUpdateMasks(const UMat &src_1, const UMat &src_2, const UMat &flicker_counter,
-                                         int max_duration, UMat &mask, std::string error)
+                                         int max_duration, UMat &mask, UMat &refined_tiles, std::string error)
 {
     if(!isAvailable(error)) {
         return false;
@@ -407,7 +443,9 @@ bool OpenCLKernels::runKernelUpdateMasks(const UMat &src_1, const UMat &src_2, c
                 cv::ocl::KernelArg::ReadOnlyNoSize(src_2),
                 cv::ocl::KernelArg::ReadWriteNoSize(flicker_counter),
                 max_duration,
-                cv::ocl::KernelArg::ReadWriteNoSize(mask)
+                cv::ocl::KernelArg::ReadWriteNoSize(mask),
+                MASK_TILE_SIZE,
+                cv::ocl::KernelArg::ReadWriteNoSize(refined_tiles)
         ).run(2, global_size, local_size, true);
     }
     if(!execution_result) {
@@ -418,6 +456,34 @@ bool OpenCLKernels::runKernelUpdateMasks(const UMat &src_1, const UMat &src_2, c
     return true;
 }
 
+bool OpenCLKernels::runKernelApplyMask(const UMat &src, const UMat &mask, const UMat &refined_tiles, UMat &dst,
+                                       std::string &error)
+{
+    if(!isAvailable(error)) {
+        return false;
+    }
+
+    size_t global_size[2] = {(size_t) src.cols, (size_t) src.rows};
+    size_t local_size[2] = {(size_t) MASK_TILE_SIZE, (size_t) MASK_TILE_SIZE};
+    bool execution_result;
+    {
+        scoped_lock<mutex> lock(kernel_apply_mask_guard);
+        execution_result = kernel_apply_mask.args(
+                cv::ocl::KernelArg::ReadOnly(src),
+                cv::ocl::KernelArg::ReadOnlyNoSize(mask),
+                MASK_TILE_SIZE,
+                cv::ocl::KernelArg::ReadOnlyNoSize(refined_tiles),
+                cv::ocl::KernelArg::WriteOnlyNoSize(dst)
+        ).run(2, global_size, local_size, true);
+    }
+    if(!execution_result) {
+        error = "OpenCL kernel: kernel_apply_mask launch failed.";
+        return false;
+    }
+
+    return true;
+}
+
 bool OpenCLKernels::runKernelZeroFlickerCounter(int max_duration, UMat &flicker_counter, std::string &error)
 {
     if(!isAvailable(error)) {
@@ -23,6 +23,14 @@ protected:
      */
     static const char *kernels_src;
 
+public:
+    /**
+     * @brief Size in pixels of the side of square tiles of flags of refined masks. It is equal to the size of work
+     * groups.
+     */
+    static const int MASK_TILE_SIZE;
+
+protected:
     /**
      * @brief String with descriptions of problems when an error occurs. It is set together with <b>opencl_available</b>
      * boolean flag.
@@ -43,6 +51,7 @@ protected:
     cv::ocl::Kernel kernel_update_similarity_levels;
     cv::ocl::Kernel kernel_update_flicker_counter;
     cv::ocl::Kernel kernel_update_masks;
+    cv::ocl::Kernel kernel_apply_mask;
     cv::ocl::Kernel kernel_zero_flicker_counter;
     cv::ocl::Kernel kernel_calculate_filtered_diff;
     cv::ocl::Kernel kernel_calculate_accumulated_diff;
@@ -53,6 +62,7 @@ protected:
     mutable std::mutex kernel_update_similarity_levels_guard;
     mutable std::mutex kernel_update_flicker_counter_guard;
     mutable std::mutex kernel_update_masks_guard;
+    mutable std::mutex kernel_apply_mask_guard;
     mutable std::mutex kernel_zero_flicker_counter_guard;
     mutable std::mutex kernel_calculate_filtered_diff_guard;
     mutable std::mutex kernel_calculate_accumulated_diff_guard;
@@ -119,11 +129,28 @@ public:
      * @param flicker_counter
      * @param max_duration
      * @param mask
+     * @param refined_tiles Flags of tiles of <b>MASK_TILE_SIZE</b> x <b>MASK_TILE_SIZE</b> pixels. Flags of tiles with
+     * refined pixels are set to 1, other flags are not changed.
      * @param error Returned description of the problem in case of an error.
      * @return True if call was successful, false otherwise.
      */
     bool runKernelUpdateMasks(const UMat &src_1, const UMat &src_2, const UMat &flicker_counter, int max_duration,
-                              UMat &mask, std::string error);
+                              UMat &mask, UMat &refined_tiles, std::string error);
+
+    /**
+     * @brief Used by FlickerRemover to subtract the mask from the frame with saturation to 0-255, like
+     * <b>cv::subtract()</b>. Masks are zero in tiles in which no pixel was refined, so there pixels are only copied
+     * and masks are not read. Tiles are as big as work groups, so all work items of the group take the same branch.
+     * It is synchronous (it waits for the processing on GPU to finish).
+     * @param src Source frame with 1 channel unsigned char pixels.
+     * @param mask Mask with short values.
+     * @param refined_tiles Flags of tiles updated by <b>runKernelUpdateMasks()</b>.
+     * @param dst Returned frame of the same size and type as <b>src</b>.
+     * @param error Returned description of the problem in case of an error.
+     * @return True if call was successful, false otherwise.
+     */
+    bool runKernelApplyMask(const UMat &src, const UMat &mask, const UMat &refined_tiles, UMat &dst,
+                            std::string &error);
 
     /**
      * @brief Used by FlickerRemover to run part of its algorithm on a GPU. It is synchronous (it waits for the
@@ -0,0 +1,123 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#include "segmented_flicker_remover.hpp"
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+
+using std::to_string;
+
+SegmentedFlickerRemover::SegmentedFlickerRemover(ThreadPool &thread_pool, unsigned int camera_fps,
+                                                 int flickering_threshold, int max_allowed_flicker_duration,
+                                                 int frame_rows, int frame_cols, FrameStorage frame_storage,
+                                                 SimilarityCounters similarity_counters, FrameLayout frame_layout)
+        : thread_pool(thread_pool), camera_fps(camera_fps), flickering_threshold(flickering_threshold),
+          max_allowed_flicker_duration(max_allowed_flicker_duration), frame_rows(frame_rows), frame_cols(frame_cols),
+          frame_storage(frame_storage), similarity_counters(similarity_counters), frame_layout(frame_layout)
+{
+}
+
+SegmentedFlickerRemover::~SegmentedFlickerRemover() = default;
+
+void SegmentedFlickerRemover::splitIntoSegments(unsigned long number_of_frames, unsigned int number_of_segments,
+                                                unsigned int block_size, unsigned int warm_up_duration,
+                                                vector<Segment> &segments)
+{
+    segments.clear();
+    const unsigned long number_of_blocks = (number_of_frames + block_size - 1) / block_size;
+    unsigned long begin = 0;
+    for(unsigned int s = 1; s <= number_of_segments; s++) {
+        //boundaries are rounded to blocks, so frames keep the mask phase of the sequential run
+        const unsigned long end = std::min(number_of_frames, number_of_blocks * s / number_of_segments * block_size);
+        if(end > begin) {
+            segments.push_back(Segment{begin > warm_up_duration ? begin - warm_up_duration : 0, begin, end});
+            begin = end;
+        }
+    }
+}
+
+bool SegmentedFlickerRemover::process(unsigned long number_of_frames, unsigned int number_of_segments,
+                                      const FrameReader &reader, const FrameWriter &writer, string &error)
+{
+    if(number_of_segments == 0) {
+        error = "Frames cannot be processed. Number of segments must be bigger than 0.";
+        return false;
+    }
+    vector<std::unique_ptr<FlickerRemoverCPU>> flicker_removers;
+    vector<Segment> segments;
+    try {
+        //tiles of frames are processed by the same pool as segments, so threads are never oversubscribed
+        flicker_removers.emplace_back(
+                new FlickerRemoverCPU(camera_fps, flickering_threshold, max_allowed_flicker_duration, frame_rows,
+                                      frame_cols, frame_storage, similarity_counters, frame_layout, &thread_pool));
+        //warm-up duration is a whole number of blocks, so warm-up frames start at the boundary of the block too
+        splitIntoSegments(number_of_frames, number_of_segments, flicker_removers[0]->getNumberOfStoredFrames(),
+                          flicker_removers[0]->getWarmUpDuration(), segments);
+        for(size_t j = 1; j < segments.size(); j++) {
+            flicker_removers.emplace_back(
+                    new FlickerRemoverCPU(camera_fps, flickering_threshold, max_allowed_flicker_duration, frame_rows,
+                                          frame_cols, frame_storage, similarity_counters, frame_layout,
+                                          &thread_pool));
+        }
+    } catch(const std::exception &ex) {
+        error = "Frames cannot be processed. " + string(ex.what());
+        return false;
+    }
+
+    std::atomic<bool> failed(false);
+    vector<string> errors(segments.size());
+    thread_pool.parallelFor((unsigned int) segments.size(), [&](unsigned int begin, unsigned int end) {
+        for(unsigned int j = begin; j < end; j++) {
+            if(!processSegment(j, segments[j], *flicker_removers[j], reader, writer, failed, errors[j])) {
+                failed = true;
+            }
+        }
+    });
+    if(failed) {
+        for(unsigned int j = 0; j < segments.size(); j++) {
+            if(!errors[j].empty()) {
+                error = "Segment " + to_string(j) + " failed. " + errors[j];
+                break;
+            }
+        }
+        return false;
+    }
+    return true;
+}
+
+bool SegmentedFlickerRemover::processSegment(unsigned int index, const Segment &segment,
+                                             FlickerRemoverCPU &flicker_remover, const FrameReader &reader,
+                                             const FrameWriter &writer, const std::atomic<bool> &failed,
+                                             string &error)
+{
+    //one block per batch, so all tiles of the state pass through the whole block while they are in cache
+    const unsigned int batch_size = flicker_remover.getNumberOfStoredFrames();
+    vector<Mat> frames(batch_size);
+    vector<double> timestamps(batch_size);
+    vector<Mat> frames_without_flickering;
+    for(unsigned long first = segment.warm_up_begin; first < segment.end; first += batch_size) {
+        if(failed) {
+            return false;
+        }
+        const auto number_of_frames = (unsigned int) std::min((unsigned long) batch_size, segment.end - first);
+        frames.resize(number_of_frames);
+        timestamps.resize(number_of_frames);
+        for(unsigned int k = 0; k < number_of_frames; k++) {
+            if(!reader(index, first + k, frames[k], timestamps[k], error)) {
+                return false;
+            }
+        }
+        if(!flicker_remover.processBatch(frames, timestamps, frames_without_flickering, error)) {
+            return false;
+        }
+        for(unsigned int k = 0; k < number_of_frames; k++) {
+            //outputs of warm-up frames are discarded
+            if(first + k >= segment.begin && !writer(index, first + k, frames_without_flickering[k], error)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
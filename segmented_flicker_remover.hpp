@@ -0,0 +1,148 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#ifndef SEGMENTED_FLICKER_REMOVER_HPP
+#define SEGMENTED_FLICKER_REMOVER_HPP
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "flicker_remover_cpu.hpp"
+#include "thread_pool.hpp"
+
+using cv::Mat;
+using std::string;
+using std::vector;
+
+/**
+ * @brief Offline removal of flickering from one long recording split into segments processed in parallel.
+ *
+ * Every segment has its own FlickerRemoverCPU, which starts <b>getWarmUpDuration()</b> frames before the segment, so
+ * its masks are learnt before the first frame of the segment is written. Outputs of warm-up frames are discarded.
+ * Boundaries of segments are multiples of the number of frames per block and the warm-up is a whole number of
+ * blocks, so every frame gets the same mask phase as in a sequential run and the stitched result closely matches it.
+ * It matches exactly in the first segment and wherever masks learnt during the warm-up are the same as masks learnt
+ * from the whole preceding recording. Frames dropped by the camera before the warm-up of the segment are not seen by
+ * its flicker remover, so segments are meant for recordings without such gaps.
+ *
+ * Segments are processed by threads of the shared pool, tiles of their frames too, so idle threads help with
+ * segments which are still processed. Inside a segment frames are processed in batches of one block with
+ * <b>FlickerRemoverCPU::processBatch()</b>.
+ */
+class SegmentedFlickerRemover {
+public:
+    /**
+     * @brief Reads the frame of the recording. For one segment frames are read in increasing order, starting from its
+     * first warm-up frame, so one decoder per segment may be kept and moved only at the start of the segment.
+     * Different segments are read at the same time from different threads.
+     * @param segment Index of the segment.
+     * @param index Index of the frame in the recording.
+     * @param frame Returned frame.
+     * @param timestamp Returned timestamp of the frame in milliseconds.
+     * @param error Returned description of the problem if an error occurs.
+     * @return True if the frame was read, false otherwise.
+     */
+    typedef std::function<bool(unsigned int segment, unsigned long index, Mat &frame, double &timestamp,
+                               string &error)> FrameReader;
+
+    /**
+     * @brief Receives the frame with removed flickering. Frames of one segment are written in increasing order,
+     * frames of different segments at the same time from different threads, so the receiver stitches them with their
+     * indexes.
+     * @param segment Index of the segment.
+     * @param index Index of the frame in the recording.
+     * @param frame Frame with removed flickering.
+     * @param error Returned description of the problem if an error occurs.
+     * @return True if the frame was written, false otherwise.
+     */
+    typedef std::function<bool(unsigned int segment, unsigned long index, const Mat &frame, string &error)>
+            FrameWriter;
+
+    /**
+     * @brief Range of frames of one segment.
+     */
+    struct Segment {
+        /**
+         * @brief First frame read to warm up the flicker remover of the segment.
+         */
+        unsigned long warm_up_begin;
+
+        /**
+         * @brief First written frame.
+         */
+        unsigned long begin;
+
+        /**
+         * @brief Frame after the last written frame.
+         */
+        unsigned long end;
+    };
+
+protected:
+    /**
+     * @brief Pool of threads processing segments and tiles of their frames. It is not owned by this object.
+     */
+    ThreadPool &thread_pool;
+
+    /**
+     * @brief Parameters of flicker removers of segments, see <b>FlickerRemoverCPU</b>.
+     */
+    unsigned int camera_fps;
+    int flickering_threshold;
+    int max_allowed_flicker_duration;
+    int frame_rows;
+    int frame_cols;
+    FrameStorage frame_storage;
+    SimilarityCounters similarity_counters;
+    FrameLayout frame_layout;
+
+    /**
+     * @brief Splits frames into segments with boundaries at multiples of the block size. Empty segments are skipped.
+     */
+    static void splitIntoSegments(unsigned long number_of_frames, unsigned int number_of_segments,
+                                  unsigned int block_size, unsigned int warm_up_duration, vector<Segment> &segments);
+
+    /**
+     * @brief Reads, processes and writes frames of one segment. It stops early if other segment failed.
+     * @return True if all frames of the segment were written, false otherwise.
+     */
+    bool processSegment(unsigned int index, const Segment &segment, FlickerRemoverCPU &flicker_remover,
+                        const FrameReader &reader, const FrameWriter &writer, const std::atomic<bool> &failed,
+                        string &error);
+
+public:
+    /**
+     * @brief Constructor. See <b>FlickerRemoverCPU</b> for the description of parameters of flicker removers.
+     * @param thread_pool Pool of threads processing segments. It must outlive this object and it may be shared with
+     * other objects.
+     */
+    SegmentedFlickerRemover(ThreadPool &thread_pool, unsigned int camera_fps, int flickering_threshold,
+                            int max_allowed_flicker_duration, int frame_rows, int frame_cols,
+                            FrameStorage frame_storage = FrameStorage::WIDE,
+                            SimilarityCounters similarity_counters = SimilarityCounters::BYTES,
+                            FrameLayout frame_layout = FrameLayout::PLANAR);
+
+    /**
+     * @brief Default destructor.
+     */
+    virtual ~SegmentedFlickerRemover();
+
+    /**
+     * @brief Removes flickering from all frames of the recording.
+     * @param number_of_frames Number of frames of the recording.
+     * @param number_of_segments Number of segments processed in parallel, usually the number of threads. Short
+     * recordings are split into fewer segments, at least one block of frames each.
+     * @param reader Source of frames.
+     * @param writer Receiver of frames with removed flickering.
+     * @param error Returned description of the problem if an error occurs.
+     * @return True if all frames were written, false otherwise.
+     */
+    bool process(unsigned long number_of_frames, unsigned int number_of_segments, const FrameReader &reader,
+                 const FrameWriter &writer, string &error);
+};
+
+
+#endif //SEGMENTED_FLICKER_REMOVER_HPP
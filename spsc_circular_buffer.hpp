@@ -0,0 +1,273 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#ifndef SPSC_CIRCULAR_BUFFER_HPP
+#define SPSC_CIRCULAR_BUFFER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+
+template<class T>
+class SPSCCircularBuffer;
+
+
+/**
+ * @brief Constant length, lock-free buffer of pointers to elements of type T passed from one producer thread to one
+ * consumer thread.
+ *
+ * It is the thread-safe companion of CircularBuffer with the same order and indexes of elements. The producer adds
+ * pointers at the end of the buffer with <b>push()</b>, the consumer removes them from the beginning with <b>pop()</b>
+ * and may look at stored pointers with <b>operator[]</b>, <b>first()</b> and <b>last()</b>. Pushing to a full buffer
+ * fails instead of removing the first element, because only the consumer may remove elements.
+ *
+ * Numbers of pushed and popped elements are atomic counters placed in separate cache lines, and every thread keeps a
+ * cached copy of the counter of the other thread, which is reloaded only when the buffer looks full (producer) or empty
+ * (consumer). So in the steady state threads do not share written cache lines and no lock is taken. The alignment of
+ * members pads the whole buffer to cache lines, so it does not share them with neighbouring objects either.
+ *
+ * @tparam T A type of elements to which pointers will be stored in buffer. It can be any type.
+ */
+template<class T>
+class SPSCCircularBuffer<T *> {
+protected:
+    static const size_t CACHE_LINE_SIZE = 64;
+
+    /**
+     * The length of the buffer. Maximum number of pointers to elements that can be stored in the buffer.
+     */
+    const unsigned int count_of_slots;
+
+    /**
+     *  Internal data structure. Simple table with as many elements of <b>T *</b> type as the length of the buffer.
+     *  Element number <b>n</b> is stored at <b>data[n % count_of_slots]</b>.
+     */
+    T **data;
+
+    /**
+     * Number of elements popped so far, written only by the consumer. It is the number of the first element.
+     */
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> popped;
+
+    /**
+     * Copy of <b>pushed</b> seen by the consumer.
+     */
+    uint64_t consumer_pushed;
+
+    /**
+     * Number of elements pushed so far, written only by the producer. It is the number of the element after the last
+     * one.
+     */
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> pushed;
+
+    /**
+     * Copy of <b>popped</b> seen by the producer.
+     */
+    uint64_t producer_popped;
+
+    /**
+     * @brief Number of elements visible to the consumer. It reloads the counter of the producer.
+     */
+    unsigned int consumerSize() const;
+
+public:
+    /**
+     * @brief Buffer constructor. Throws std::logic_error if the size is 0.
+     * @param size Length of the buffer. At most that many pointers to elements of type T will be stored in the buffer.
+     */
+    explicit SPSCCircularBuffer(unsigned int size);
+    SPSCCircularBuffer(const SPSCCircularBuffer &) = delete;
+    SPSCCircularBuffer &operator=(const SPSCCircularBuffer &) = delete;
+
+    /**
+     * @brief Buffer destructor.
+     *
+     * Frees memory of the internal buffer, but does not free memory pointed by pointers to elements.
+     */
+    ~SPSCCircularBuffer();
+
+    /**
+     * @brief Inserts pointer to element at the end of the buffer. Called only by the producer.
+     * @param element Pointer to element that will be stored in the buffer.
+     * @return True if the pointer was stored, false if the buffer is full.
+     */
+    bool push(T *element);
+
+    /**
+     * @brief Removes and returns pointer to the first element in the buffer. Called only by the consumer.
+     * @return Removed pointer from the buffer or <b>nullptr</b> when the buffer is empty.
+     */
+    T *pop();
+
+    /**
+     * @brief Random access operator. Called only by the consumer, see <b>CircularBuffer::operator[]</b>.
+     * @param index Number of returned element starting form 0 as the first element. It can be a negative value: -1
+     * means the last element, -2 means one before the last element and so on.
+     * @return Pointer to the element stored at <b>index</b> position or <b>nullptr</b> if there is no such element.
+     */
+    T *operator[](int index) const;
+
+    /**
+     * @brief Returns pointer to the last element in the buffer or <b>nullptr</b> when the buffer is empty. Called only
+     * by the consumer.
+     */
+    T *last() const;
+
+    /**
+     * @brief Returns pointer to the first element in the buffer or <b>nullptr</b> when the buffer is empty. Called
+     * only by the consumer.
+     */
+    T *first() const;
+
+    /**
+     * @brief Number of pointers to elements stored in the buffer. Called from the other thread than the owner of the
+     * changed end, it is only a snapshot.
+     */
+    unsigned int size() const;
+
+    /**
+     * @brief Maximum number of pointers to elements that can be stored in the buffer.
+     */
+    unsigned int maxSize() const;
+
+    /**
+     * @brief True if the buffer is full. It stays full until the consumer pops an element.
+     */
+    bool isFull() const;
+
+    /**
+     * @brief True if the buffer is empty. It stays empty until the producer pushes an element.
+     */
+    bool isEmpty() const;
+};
+
+
+//------------------------------ IMPLEMENTATION ------------------------------
+
+template<class T>
+SPSCCircularBuffer<T *>::SPSCCircularBuffer(unsigned int size)
+    : count_of_slots(size), data(nullptr), popped(0), consumer_pushed(0), pushed(0), producer_popped(0)
+{
+    if(count_of_slots == 0) {
+        throw std::logic_error("Size must be bigger than 0.");
+    }
+    data = new T *[count_of_slots];
+    for(unsigned int i = 0; i < count_of_slots; i++) {
+        data[i] = nullptr;
+    }
+}
+
+
+template<class T>
+SPSCCircularBuffer<T *>::~SPSCCircularBuffer()
+{
+    delete[] data;
+}
+
+
+template<class T>
+bool SPSCCircularBuffer<T *>::push(T *element)
+{
+    //only the producer writes the counter of pushed elements, so it can be read without synchronization
+    const uint64_t number = pushed.load(std::memory_order_relaxed);
+    if(number - producer_popped == count_of_slots) {
+        //the buffer looked full last time, check if the consumer popped something since then
+        producer_popped = popped.load(std::memory_order_acquire);
+        if(number - producer_popped == count_of_slots) {
+            return false;
+        }
+    }
+    data[number % count_of_slots] = element;
+    //release publishes the stored pointer together with the new counter
+    pushed.store(number + 1, std::memory_order_release);
+    return true;
+}
+
+
+template<class T>
+T *SPSCCircularBuffer<T *>::pop()
+{
+    const uint64_t number = popped.load(std::memory_order_relaxed);
+    if(number == consumer_pushed) {
+        //the buffer looked empty last time, check if the producer pushed something since then
+        consumer_pushed = pushed.load(std::memory_order_acquire);
+        if(number == consumer_pushed) {
+            return nullptr;
+        }
+    }
+    T *ret = data[number % count_of_slots];
+    //release makes sure that the pointer is read before the producer may overwrite its slot
+    popped.store(number + 1, std::memory_order_release);
+    return ret;
+}
+
+
+template<class T>
+unsigned int SPSCCircularBuffer<T *>::consumerSize() const
+{
+    //elements pushed after this load are not visible, which is fine for the consumer
+    const uint64_t number_of_pushed = pushed.load(std::memory_order_acquire);
+    return (unsigned int) (number_of_pushed - popped.load(std::memory_order_relaxed));
+}
+
+
+template<class T>
+T *SPSCCircularBuffer<T *>::operator[](int index) const
+{
+    const unsigned int count_of_elements = consumerSize();
+    if(count_of_elements == 0 || index > ((int) count_of_elements) - 1 || index < -1 * ((int) count_of_elements)) {
+        return nullptr;
+    }
+    const uint64_t first_number = popped.load(std::memory_order_relaxed);
+    if(index >= 0) {
+        return data[(first_number + index) % count_of_slots];
+    } else {
+        return data[(first_number + count_of_elements + index) % count_of_slots];
+    }
+}
+
+
+template<class T>
+T *SPSCCircularBuffer<T *>::last() const
+{
+    return (*this)[-1];
+}
+
+
+template<class T>
+T *SPSCCircularBuffer<T *>::first() const
+{
+    return (*this)[0];
+}
+
+
+template<class T>
+unsigned int SPSCCircularBuffer<T *>::size() const
+{
+    //popped is loaded first, so the difference never underflows
+    const uint64_t number_of_popped = popped.load(std::memory_order_acquire);
+    return (unsigned int) (pushed.load(std::memory_order_acquire) - number_of_popped);
+}
+
+template<class T>
+unsigned int SPSCCircularBuffer<T *>::maxSize() const
+{
+    return count_of_slots;
+}
+
+template<class T>
+bool SPSCCircularBuffer<T *>::isFull() const
+{
+    return (size() == count_of_slots);
+}
+
+template<class T>
+bool SPSCCircularBuffer<T *>::isEmpty() const
+{
+    return (size() == 0);
+}
+
+#endif //SPSC_CIRCULAR_BUFFER_HPP
@@ -0,0 +1,114 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#include "state_file.hpp"
+#include <cstdio>
+
+namespace {
+/**
+ * @brief Identifier written at the beginning of every state file.
+ */
+const char MAGIC[4] = {'F', 'R', 'S', 'T'};
+}
+
+StateWriter::StateWriter(const string &path, const string &kind, uint32_t version)
+        : path(path), stream(path + ".tmp", std::ios::binary | std::ios::trunc)
+{
+    write(MAGIC, sizeof(MAGIC));
+    write((uint32_t) kind.size());
+    write(kind.data(), kind.size());
+    write(version);
+}
+
+void StateWriter::write(const void *data, size_t size)
+{
+    stream.write((const char *) data, (std::streamsize) size);
+}
+
+void StateWriter::writeMatrix(const cv::Mat &matrix)
+{
+    const size_t row_size = matrix.cols * matrix.elemSize();
+    for(int row = 0; row < matrix.rows; row++) {
+        write(matrix.ptr(row), row_size);
+    }
+}
+
+bool StateWriter::commit(string &error)
+{
+    stream.close();
+    if(stream.fail()) {
+        std::remove((path + ".tmp").c_str());
+        error = "State cannot be saved. Writing to the file failed: " + path + ".tmp";
+        return false;
+    }
+    if(std::rename((path + ".tmp").c_str(), path.c_str()) != 0) {
+        std::remove((path + ".tmp").c_str());
+        error = "State cannot be saved. File cannot be replaced: " + path;
+        return false;
+    }
+    return true;
+}
+
+StateReader::StateReader(const string &path, const string &kind, uint32_t version)
+        : stream(path, std::ios::binary)
+{
+    if(!stream.is_open()) {
+        problem = "File cannot be opened: " + path + ".";
+        return;
+    }
+    char magic[sizeof(MAGIC)] = {};
+    read(magic, sizeof(magic));
+    string file_kind(read<uint32_t>() == kind.size() ? kind.size() : 0, '\0');
+    read(&file_kind[0], file_kind.size());
+    if(!isValid() || std::char_traits<char>::compare(magic, MAGIC, sizeof(MAGIC)) != 0 || file_kind != kind) {
+        problem = "File does not contain the state of " + kind + ": " + path + ".";
+        return;
+    }
+    uint32_t file_version = read<uint32_t>();
+    if(isValid() && file_version != version) {
+        problem = "Unsupported version of the state: " + std::to_string(file_version) + ". Expected version: " +
+                  std::to_string(version) + ".";
+    }
+}
+
+void StateReader::read(void *data, size_t size)
+{
+    if(!problem.empty()) {
+        return;
+    }
+    stream.read((char *) data, (std::streamsize) size);
+    if(!stream) {
+        problem = "File is truncated.";
+    }
+}
+
+void StateReader::readMatrix(cv::Mat &matrix)
+{
+    const size_t row_size = matrix.cols * matrix.elemSize();
+    for(int row = 0; row < matrix.rows; row++) {
+        read(matrix.ptr(row), row_size);
+    }
+}
+
+bool StateReader::finish(string &error)
+{
+    if(problem.empty() && stream.peek() != std::char_traits<char>::eof()) {
+        problem = "File has unexpected data after the state.";
+    }
+    if(!problem.empty()) {
+        error = "State cannot be restored. " + problem;
+        return false;
+    }
+    return true;
+}
+
+bool StateReader::isValid() const
+{
+    return problem.empty();
+}
+
+const string &StateReader::getProblem() const
+{
+    return problem;
+}
@@ -0,0 +1,135 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#ifndef STATE_FILE_HPP
+#define STATE_FILE_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <opencv2/opencv.hpp>
+
+using std::string;
+
+/**
+ * @brief Writes the learnt state of the flicker remover to a binary file. The file starts with a header identifying
+ * the kind of the state and its version, and all values are written in the native byte order, so states are meant to
+ * be restored on the same machine, for example after a restart of the service. Data is written to a temporary file
+ * which replaces the target file only in <b>commit()</b>, so the previous state is never left half overwritten.
+ */
+class StateWriter {
+protected:
+    /**
+     * @brief Path of the target file.
+     */
+    string path;
+
+    /**
+     * @brief Stream of the temporary file.
+     */
+    std::ofstream stream;
+
+public:
+    /**
+     * @brief Constructor. Opens the temporary file and writes the header.
+     * @param path Path of the target file.
+     * @param kind Identifier of the kind of the state, checked when the state is read.
+     * @param version Version of the format of the state, checked when the state is read.
+     */
+    StateWriter(const string &path, const string &kind, uint32_t version);
+
+    /**
+     * @brief Writes raw bytes.
+     */
+    void write(const void *data, size_t size);
+
+    /**
+     * @brief Writes one value of a trivially copyable type.
+     */
+    template<typename T>
+    void write(const T &value)
+    {
+        write(&value, sizeof(T));
+    }
+
+    /**
+     * @brief Writes all elements of the matrix row after row. Its size and type are not written, so they must be known
+     * when the state is read.
+     */
+    void writeMatrix(const cv::Mat &matrix);
+
+    /**
+     * @brief Closes the temporary file and moves it in place of the target file.
+     * @param error Returned description of the problem if an error occurs.
+     * @return True if the whole state was written, false otherwise.
+     */
+    bool commit(string &error);
+};
+
+/**
+ * @brief Reads the state written by StateWriter. Reading past the end of the file or a mismatch of the header makes
+ * the reader fail, which is checked with <b>isValid()</b>.
+ */
+class StateReader {
+protected:
+    /**
+     * @brief Stream of the file.
+     */
+    std::ifstream stream;
+
+    /**
+     * @brief Description of the first problem or an empty string.
+     */
+    string problem;
+
+public:
+    /**
+     * @brief Constructor. Opens the file and checks its header.
+     * @param path Path of the file.
+     * @param kind Expected identifier of the kind of the state.
+     * @param version Expected version of the format of the state.
+     */
+    StateReader(const string &path, const string &kind, uint32_t version);
+
+    /**
+     * @brief Reads raw bytes.
+     */
+    void read(void *data, size_t size);
+
+    /**
+     * @brief Reads one value of a trivially copyable type. It is zeroed if the reader fails.
+     */
+    template<typename T>
+    T read()
+    {
+        T value{};
+        read(&value, sizeof(T));
+        return value;
+    }
+
+    /**
+     * @brief Reads all elements of the preallocated matrix row after row.
+     */
+    void readMatrix(cv::Mat &matrix);
+
+    /**
+     * @brief Checks that the whole file was read and no problem occurred.
+     * @param error Returned description of the problem if an error occurs.
+     * @return True if the state was read correctly, false otherwise.
+     */
+    bool finish(string &error);
+
+    /**
+     * @brief True if no problem occurred so far.
+     */
+    [[nodiscard]] bool isValid() const;
+
+    /**
+     * @brief Returns description of the first problem, or an empty string if there was no problem.
+     */
+    [[nodiscard]] const string &getProblem() const;
+};
+
+
+#endif //STATE_FILE_HPP
@@ -0,0 +1,141 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cstdint>
+
+const unsigned int ThreadPool::TASKS_PER_THREAD = 4;
+
+ThreadPool::ThreadPool(unsigned int number_of_threads)
+        : queued_tasks(0), next_queue(0), stopping(false)
+{
+    if(number_of_threads == 0) {
+        unsigned int hardware_threads = std::thread::hardware_concurrency();
+        number_of_threads = hardware_threads > 1 ? hardware_threads - 1 : 0;
+    }
+    for(unsigned int i = 0; i < number_of_threads; i++) {
+        queues.emplace_back(new Queue());
+    }
+    //queues are created before threads start, so threads can steal from all of them
+    workers.reserve(number_of_threads);
+    for(unsigned int i = 0; i < number_of_threads; i++) {
+        workers.emplace_back(&ThreadPool::work, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleep_guard);
+        stopping = true;
+    }
+    work_available.notify_all();
+    for(auto &worker: workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(unsigned int number_of_items,
+                             const std::function<void(unsigned int, unsigned int)> &body)
+{
+    if(number_of_items == 0) {
+        return;
+    }
+    const auto number_of_queues = (unsigned int) queues.size();
+    const unsigned int number_of_tasks = std::min(number_of_items, (number_of_queues + 1) * TASKS_PER_THREAD);
+    if(number_of_queues == 0 || number_of_tasks == 1) {
+        body(0, number_of_items);
+        return;
+    }
+
+    Loop loop;
+    loop.body = &body;
+    loop.remaining_tasks = number_of_tasks;
+    //consecutive ranges go to different queues, so threads start with tasks far from each other
+    unsigned int queue = next_queue.fetch_add(1) % number_of_queues;
+    for(unsigned int j = 0; j < number_of_tasks; j++) {
+        Task task{&loop, (unsigned int) ((uint64_t) number_of_items * j / number_of_tasks),
+                  (unsigned int) ((uint64_t) number_of_items * (j + 1) / number_of_tasks)};
+        {
+            std::lock_guard<std::mutex> lock(queues[queue]->guard);
+            queues[queue]->tasks.push_back(task);
+            queued_tasks++;
+        }
+        queue = (queue + 1) % number_of_queues;
+    }
+    {
+        //threads which checked the counter before tasks were queued are already waiting when the lock is taken, so
+        //they cannot miss the notification
+        std::lock_guard<std::mutex> lock(sleep_guard);
+    }
+    work_available.notify_all();
+
+    //the calling thread helps instead of waiting, it may also execute tasks of other loops
+    Task task{};
+    while(loop.remaining_tasks.load() != 0 && takeTask(queue, task)) {
+        runTask(task);
+    }
+    std::unique_lock<std::mutex> lock(loop.guard);
+    loop.finished.wait(lock, [&loop]() {
+        return loop.remaining_tasks.load() == 0;
+    });
+}
+
+unsigned int ThreadPool::getNumberOfThreads() const
+{
+    return (unsigned int) workers.size();
+}
+
+void ThreadPool::work(unsigned int index)
+{
+    Task task{};
+    while(true) {
+        if(takeTask(index, task)) {
+            runTask(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_guard);
+        work_available.wait(lock, [this]() {
+            return stopping || queued_tasks.load() != 0;
+        });
+        if(stopping) {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::takeTask(unsigned int index, Task &task)
+{
+    const auto number_of_queues = (unsigned int) queues.size();
+    for(unsigned int j = 0; j < number_of_queues; j++) {
+        Queue &queue = *queues[(index + j) % number_of_queues];
+        std::lock_guard<std::mutex> lock(queue.guard);
+        if(queue.tasks.empty()) {
+            continue;
+        }
+        //own tasks are taken from the front, stolen ones from the back
+        if(j == 0) {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+        } else {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        }
+        queued_tasks--;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::runTask(const Task &task)
+{
+    (*task.loop->body)(task.begin, task.end);
+    Loop &loop = *task.loop;
+    //the loop lives on the stack of the thread which waits for it, so it must not be touched after notification
+    std::lock_guard<std::mutex> lock(loop.guard);
+    if(--loop.remaining_tasks == 0) {
+        loop.finished.notify_all();
+    }
+}
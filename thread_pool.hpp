@@ -0,0 +1,158 @@
+//
+// Created by agent on 16.10.2026.
+//
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Persistent pool of worker threads running parallel loops with work stealing.
+ *
+ * Threads are started once in the constructor and live as long as the pool, so a parallel loop does not create or
+ * wake up a separate team of threads. Every thread has its own queue of tasks. Tasks of a loop are spread over all
+ * queues, every thread takes tasks from the front of its own queue and, when it is empty, steals tasks from the backs
+ * of queues of other threads. The thread which runs the loop also executes tasks until the loop is finished, so the
+ * whole loop has a single barrier at its end.
+ *
+ * One pool may be shared by many objects (for example by FlickerRemoverCPU instances processing different cameras)
+ * and loops may be run from many threads at the same time. Tasks of all loops are executed by the same threads, so
+ * the machine is not oversubscribed.
+ */
+class ThreadPool {
+protected:
+    /**
+     * @brief State of one running parallel loop. It is owned by the thread running the loop.
+     */
+    struct Loop {
+        /**
+         * @brief Body of the loop called for ranges of items.
+         */
+        const std::function<void(unsigned int, unsigned int)> *body;
+
+        /**
+         * @brief Number of tasks of the loop which are not finished yet.
+         */
+        std::atomic<unsigned int> remaining_tasks;
+
+        /**
+         * @brief Guards notification about the end of the loop.
+         */
+        std::mutex guard;
+        std::condition_variable finished;
+    };
+
+    /**
+     * @brief Range of items of one loop executed as one task.
+     */
+    struct Task {
+        Loop *loop;
+        unsigned int begin;
+        unsigned int end;
+    };
+
+    /**
+     * @brief Queue of tasks of one worker thread.
+     */
+    struct Queue {
+        std::mutex guard;
+        std::deque<Task> tasks;
+    };
+
+    /**
+     * @brief Number of tasks created for one thread (including the thread running the loop). More tasks than threads
+     * let threads which finish early steal work from slower ones.
+     */
+    static const unsigned int TASKS_PER_THREAD;
+
+    /**
+     * @brief Queues of tasks, one per worker thread.
+     */
+    std::vector<std::unique_ptr<Queue>> queues;
+
+    /**
+     * @brief Worker threads.
+     */
+    std::vector<std::thread> workers;
+
+    /**
+     * @brief Number of tasks in all queues.
+     */
+    std::atomic<unsigned int> queued_tasks;
+
+    /**
+     * @brief Queue which gets the first task of the next loop, so loops run at the same time start in different
+     * queues.
+     */
+    std::atomic<unsigned int> next_queue;
+
+    /**
+     * @brief Set when the pool is destroyed and worker threads should exit.
+     */
+    bool stopping;
+
+    /**
+     * @brief Guards sleeping of idle worker threads.
+     */
+    std::mutex sleep_guard;
+    std::condition_variable work_available;
+
+    /**
+     * @brief Main loop of the worker thread.
+     * @param index Index of the queue of the thread.
+     */
+    void work(unsigned int index);
+
+    /**
+     * @brief Takes one task from the front of the queue <b>index</b> or steals it from the back of other queues.
+     * @param index Index of the preferred queue.
+     * @param task Returned task.
+     * @return True if a task was taken, false if all queues are empty.
+     */
+    bool takeTask(unsigned int index, Task &task);
+
+    /**
+     * @brief Executes the task and notifies the thread running its loop if it was the last task of the loop.
+     */
+    static void runTask(const Task &task);
+
+public:
+    /**
+     * @brief Constructor. Starts worker threads.
+     * @param number_of_threads Number of worker threads. The thread running a loop also executes its tasks, so 0 means
+     * one less than the number of hardware threads.
+     */
+    explicit ThreadPool(unsigned int number_of_threads = 0);
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * @brief Destructor. Waits for worker threads to finish. No loop may be running.
+     */
+    virtual ~ThreadPool();
+
+    /**
+     * @brief Runs the body of the loop for all items from range [0, number_of_items) and returns when all of them
+     * are processed. Items are split into continuous ranges processed in parallel by worker threads and the calling
+     * thread. The body must not throw exceptions.
+     * @param number_of_items Number of items of the loop.
+     * @param body Function called with ranges [begin, end) of items. It is called from many threads at the same time.
+     */
+    void parallelFor(unsigned int number_of_items, const std::function<void(unsigned int, unsigned int)> &body);
+
+    /**
+     * @brief Number of worker threads.
+     */
+    [[nodiscard]] unsigned int getNumberOfThreads() const;
+};
+
+
+#endif //THREAD_POOL_HPP